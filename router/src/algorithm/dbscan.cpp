@@ -1,4 +1,5 @@
 #include "dbscan.h"
+#include "../graph/Dijkstra.h"
 #include <algorithm>
 #include <cmath>
 #include <climits>
@@ -8,6 +9,8 @@
 #include <limits>
 #include <numeric>
 #include <random>
+#include <atomic>
+#include <optional>
 
 namespace dbscan {
 
@@ -23,26 +26,17 @@ struct WalkParams {
 
 static void dijkstra_cut(Graph* g, node_t start, ld cut, bool walk, DistMap& out) {
     out.clear(); if (start < 0 || start >= (node_t)g->nodes.size()) return;
-    struct Q { ld d; node_t u; }; auto cmp = [](auto a, auto b){return a.d>b.d;};
-    std::priority_queue<Q, vector<Q>, decltype(cmp)> pq(cmp);
-    out[start]=0; pq.push({0,start});
-    while(!pq.empty()){
-        auto [d,u]=pq.top(); pq.pop();
-        if(d>cut||out[u]<d-1e-9) continue;
-        for(auto e:g->adj[u]) {
-            if((walk&&!e->is_walkable)||(!walk&&!e->is_driveable)) continue;
-            node_t v=e->v; ld nd=d+e->dist; if(nd>cut) continue;
-            if(!out.count(v)||nd<out[v]) {out[v]=nd; pq.push({nd,v});}
-        }
-    }
+    thread_local SearchScratch sc; sc.reset(g->nodes.size());
+    dijkstra(g->get_csr(walk),start,cut,sc.d,sc.touched,nullptr,[](int,ld){return false;});
+    out.reserve(sc.touched.size()); for(node_t u:sc.touched) out[u]=sc.d[u];
 }
 static node_t valid_node(Graph* g, node_t n, bool walk) {
     if (n>=0 && n<(node_t)g->nodes.size() &&
         (walk?g->nodes[n]->is_walkable:g->nodes[n]->is_driveable)) return n;
     if (n<0||n>=(node_t)g->nodes.size()) n=0;
-    return g->get_node(g->nodes[n]->coord, walk);
+    return g->get_node(*g->nodes[n]->coord, walk);
 }
-static int drive_deg(Graph* g,node_t n){int d=0;for(auto e:g->adj[n])if(e->is_driveable)d++;return d;}
+static int drive_deg(Graph* g,node_t n){return g->drive_csr.degree(n);}
 
 static node_t walk_node_safe(Graph* g,const vector<node_t>&w,int i,const vector<Student*>&S){
     node_t n=w[i]; return (n>=0&&(size_t)n<g->nodes.size())?n:g->get_node(S[i]->pos,true);
@@ -74,23 +68,30 @@ static vector<int> region_query(
 static int medoid(const vector<int>&M,const vector<node_t>&W,Graph*g,
     const vector<Student*>&S,ld max_walk){
     ld best=std::numeric_limits<ld>::max();int bi=M.front();
-    for(int i:M){ node_t ni=walk_node_safe(g,W,i,S);
-        vector<ld>d;vector<int>p; g->sssp(ni,true,d,p);
-        ld tot=0;bool bad=false;
-        for(int j:M){node_t nj=walk_node_safe(g,W,j,S);
-            if(d[nj]>max_walk+1e-6){bad=true;break;} tot+=d[nj];
-        } if(!bad&&tot<best){best=tot;bi=i;}
+    // one batch per pool width so only that many rows are alive at once
+    int B=ThreadPool::shared().size();
+    for(size_t c=0;c<M.size();c+=B){
+        vector<int>src; for(size_t k=c;k<M.size()&&k<c+B;++k)src.push_back(walk_node_safe(g,W,M[k],S));
+        vector<vector<ld>>D;vector<vector<int>>P; g->sssp_batch(src,true,D,P);
+        for(size_t k=0;k<src.size();++k){ const vector<ld>&d=D[k];
+            ld tot=0;bool bad=false;
+            for(int j:M){node_t nj=walk_node_safe(g,W,j,S);
+                if(d[nj]>max_walk+1e-6){bad=true;break;} tot+=d[nj];
+            } if(!bad&&tot<best){best=tot;bi=M[c+k];}
+        }
     } return bi;
 }
 static vector<vector<int>> make_clusters(const vector<Student*>&S,Graph*g,
     const Params&P,vector<node_t>&W,vector<node_t>&D,std::unordered_map<sid_t,int>&idmap){
-    int N=S.size(); W.resize(N); D.resize(N); idmap.clear();
-    for(int i=0;i<N;++i){W[i]=g->get_node(S[i]->pos,true);
-        D[i]=g->get_node(S[i]->pos,false); idmap[S[i]->id]=i;}
+    int N=S.size(); idmap.clear(); vector<Coordinate> pos(N);
+    for(int i=0;i<N;++i){pos[i]=S[i]->pos; idmap[S[i]->id]=i;}
+    W=g->get_node_batch(pos,true); D=g->get_node_batch(pos,false);
     ld r=(P.seed_radius>0?P.seed_radius:P.max_walk_dist);
     vector<int>lab(N,-1); int cid=0;
     std::vector<std::vector<int>> neigh_cache(N);
     std::vector<char> neigh_ready(N, false);
+    // every point ends up being queried once, so fill the cache up front in parallel
+    ThreadPool::shared().parallel_for(N,[&](int i,int){region_query(i,W,g,r,S,&neigh_cache,&neigh_ready);});
     for(int i=0;i<N;++i){ if(lab[i]!=-1)continue;
         auto n=region_query(i,W,g,r,S,&neigh_cache,&neigh_ready);
         if((int)n.size()+1<P.min_pts){lab[i]=-2;continue;}
@@ -110,8 +111,8 @@ static bool compute_distance_matrix(const vector<int>& cluster,
     const WalkParams&wp, vector<vector<ld>>& dist_out) {
     int n = cluster.size();
     dist_out.assign(n, vector<ld>(n, INFVAL));
-    bool ok = false;
-    for(int ii = 0; ii < n; ++ii) {
+    std::atomic<bool> ok{false};
+    ThreadPool::shared().parallel_for(n, [&](int ii, int) {
         node_t start = walk_node_safe(g, W, cluster[ii], S);
         DistMap dists;
         dijkstra_cut(g, start, wp.max * 3.0, true, dists);
@@ -123,7 +124,7 @@ static bool compute_distance_matrix(const vector<int>& cluster,
                 ok = true;
             }
         }
-    }
+    });
     return ok;
 }
 
@@ -256,19 +257,13 @@ static vector<vector<int>> split_cluster_kmedoids(
     return filtered;
 }
 
-struct StopCandidate{Coordinate*coord;vector<int>cover;node_t walk,drive;};
+struct StopCandidate{std::optional<Coordinate>coord;vector<int>cover;node_t walk,drive;};
 static vector<node_t> gather_drive(Graph*g,node_t s,ld lim,size_t cap){
-    DistMap best;struct Q{ld d;node_t u;};auto cmp=[](auto a,auto b){return a.d>b.d;};
-    std::priority_queue<Q,vector<Q>,decltype(cmp)>pq(cmp);
-    s=valid_node(g,s,false);best[s]=0;pq.push({0,s});vector<node_t>out;
-    while(!pq.empty()){auto[d,u]=pq.top();pq.pop();
-        if(d>lim||best[u]<d-1e-9)continue;
+    thread_local SearchScratch sc; sc.reset(g->nodes.size());
+    s=valid_node(g,s,false);vector<node_t>out;
+    dijkstra<BinaryHeap>(g->drive_csr,s,lim,sc.d,sc.touched,nullptr,[&](int u,ld){
         if(g->nodes[u]->is_driveable)out.push_back(u);
-        if(out.size()>=cap)break;
-        for(auto e:g->adj[u])if(e->is_driveable){
-            node_t v=e->v;ld nd=d+e->dist;
-            if(nd<=lim&&(!best.count(v)||nd<best[v])){best[v]=nd;pq.push({nd,v});}
-        }}
+        return out.size()>=cap;});
     if(out.empty())out.push_back(s);return out;
 }
 struct SABest {
@@ -298,6 +293,10 @@ static CandidateCache build_candidate_cache(
     cache.walk = valid_node(g, drive, true);
     cache.dists.assign(members.size(), INFVAL);
     if(cache.walk < 0) return cache;
+    // a member provably out of walking range makes the candidate invalid, skip its search
+    for(int m : members) {
+        if(g->lower_bound(cache.walk, walk_node_safe(g, W, m, S), true) > wp.max + 1e-6) return cache;
+    }
     DistMap dist;
     dijkstra_cut(g, cache.walk, wp.max, true, dist);
     for(size_t idx = 0; idx < members.size(); ++idx) {
@@ -329,12 +328,12 @@ static SABest evaluate_state_cached(
         worst = std::max(worst, d);
         cover.push_back(members[i]);
     }
-    ld pen = (drive_deg(g, cache.drive) <= 2 ? (4 - drive_deg(g, cache.drive)) * 0.4L : 0);
+    ld pen = (drive_deg(g, cache.drive) <= 2 ? (4 - drive_deg(g, cache.drive)) * 0.4 : 0);
     res.valid = true;
     res.drive = cache.drive;
     res.walk = cache.walk;
     res.cover = std::move(cover);
-    res.score = total + 0.35L * worst + pen;
+    res.score = total + 0.35 * worst + pen;
     return res;
 }
 
@@ -400,7 +399,7 @@ static StopCandidate run_simulated_annealing(
         temp *= cooling;
     }
 
-    c.coord = g->nodes[best.drive]->coord->make_copy();
+    c.coord = *g->nodes[best.drive]->coord;
     c.walk = best.walk;
     c.drive = best.drive;
     c.cover = best.cover;
@@ -420,9 +419,8 @@ static bool branch_reaches_intersection(Graph* g, node_t start, node_t next){
         if(deg >= 3){
             return true;
         }
-        for(auto e : g->adj[u]){
-            if(!e->is_driveable) continue;
-            node_t v = e->v;
+        for(int k = g->drive_csr.offset[u]; k < g->drive_csr.offset[u + 1]; ++k){
+            node_t v = g->drive_csr.target[k];
             if(vis[v]) continue;
             vis[v] = 1;
             q.push(v);
@@ -436,9 +434,8 @@ static bool has_intersections_both_sides(Graph* g, node_t start, ld /*limit*/){
     int deg = drive_deg(g,start);
     if(deg < 2) return false;
     int found = 0;
-    for(auto e : g->adj[start]){
-        if(!e->is_driveable) continue;
-        if(branch_reaches_intersection(g, start, e->v)){
+    for(int k = g->drive_csr.offset[start]; k < g->drive_csr.offset[start + 1]; ++k){
+        if(branch_reaches_intersection(g, start, g->drive_csr.target[k])){
             if(++found >= 2) return true;
         }
     }
@@ -467,13 +464,13 @@ static node_t escape_culdesac(Graph* g, node_t start, ld max_step){
             best = u;
             best_deg = deg;
         }
-        for(auto e : g->adj[u]){
-            if(!e->is_driveable) continue;
-            ld nd = dist + e->dist;
+        for(int k = g->drive_csr.offset[u]; k < g->drive_csr.offset[u + 1]; ++k){
+            node_t v = g->drive_csr.target[k];
+            ld nd = dist + g->drive_csr.weight[k];
             if(nd > max_step) continue;
-            if(vis[e->v]) continue;
-            vis[e->v] = 1;
-            q.push({e->v, nd});
+            if(vis[v]) continue;
+            vis[v] = 1;
+            q.push({v, nd});
         }
     }
     return best;
@@ -514,18 +511,17 @@ static StopCandidate build_cand(const vector<int>&M,const vector<node_t>&W,const
             eval.walk=valid_node(g,fallback,true);
             eval.cover={med};
         }
-        c.coord=g->nodes[eval.drive]->coord->make_copy();
+        c.coord=*g->nodes[eval.drive]->coord;
         c.walk=eval.walk;
         c.drive=eval.drive;
         c.cover=eval.cover;
     }
-    ld escape_limit = std::max<ld>(120.0L, std::min<ld>(200.0L, wp.max * 0.75L));
+    ld escape_limit = std::max<ld>(120.0, std::min<ld>(200.0, wp.max * 0.75));
     node_t adjusted = escape_culdesac(g, c.drive, escape_limit);
     if(adjusted != c.drive){
         SABest eval = evaluate_state(adjusted, M, W, g, S, wp);
         if(eval.valid){
-            delete c.coord;
-            c.coord = g->nodes[adjusted]->coord->make_copy();
+            c.coord = *g->nodes[adjusted]->coord;
             c.drive = adjusted;
             c.walk = eval.walk;
             c.cover = eval.cover;
@@ -668,11 +664,11 @@ static void refine(vector<BusStop*>&st,vector<node_t>&sw,vector<node_t>&sd,
     auto add_stop_for_student=[&](int idx)->size_t{
         StopCandidate cand=build_cand({idx},W,D,S,g,wp);
         if(!cand.coord){
-            cand.coord=S[idx]->pos->make_copy();
+            cand.coord=S[idx]->pos;
             cand.walk=walk_node_safe(g,W,idx,S);
             cand.drive=D[idx];
         }
-        auto*stop=new BusStop((bsid_t)st.size(),cand.coord,{});
+        auto*stop=new BusStop((bsid_t)st.size(),*cand.coord,{});
         st.push_back(stop);
         sw.push_back(cand.walk);
         sd.push_back(cand.drive);
@@ -733,17 +729,18 @@ static void merge_close_stops(
             for(size_t j = i + 1; j < st.size(); ++j) {
                 node_t nj = sd[j];
                 if(nj < 0) continue;
+                bool few = (st[i]->students.size() <= 2 && st[j]->students.size() <= 2);
+                ld relaxed = std::max<ld>(limit * 1.75, 160.0);
+                // pairs provably beyond both limits never need an exact distance
+                if(g->lower_bound(ni, nj, false) > (few ? std::max(limit, relaxed) : limit)) continue;
                 ld d = g->get_dist(ni, nj, false);
                 if(!std::isfinite(d)) continue;
-                bool few = (st[i]->students.size() <= 2 && st[j]->students.size() <= 2);
-                ld relaxed = std::max<ld>(limit * 1.75L, 160.0L);
                 if(d > limit && !(few && d <= relaxed)) continue;
                 st[i]->students.insert(
                     st[i]->students.end(),
                     st[j]->students.begin(),
                     st[j]->students.end()
                 );
-                delete st[j]->pos;
                 delete st[j];
                 st.erase(st.begin() + j);
                 sw.erase(sw.begin() + j);
@@ -837,11 +834,11 @@ static void consolidate_global(vector<BusStop*>&st,vector<node_t>&sw,vector<node
         if(group.empty()) continue;
         auto cand = build_cand(group, W, D, S, g, wp);
         if(!cand.coord) {
-            cand.coord = S[group.front()]->pos->make_copy();
+            cand.coord = S[group.front()]->pos;
             cand.walk = walk_node_safe(g, W, group.front(), S);
             cand.drive = D[group.front()];
         }
-        BusStop* stop = new BusStop((bsid_t)rebuilt.size(), cand.coord, {});
+        BusStop* stop = new BusStop((bsid_t)rebuilt.size(), *cand.coord, {});
         std::unordered_set<int> included(cand.cover.begin(), cand.cover.end());
         for(int idx : cand.cover) {
             stop->students.push_back(S[idx]->id);
@@ -860,11 +857,11 @@ static void consolidate_global(vector<BusStop*>&st,vector<node_t>&sw,vector<node
         if(covered[i]) continue;
         StopCandidate cand = build_cand({i}, W, D, S, g, wp);
         if(!cand.coord) {
-            cand.coord = S[i]->pos->make_copy();
+            cand.coord = S[i]->pos;
             cand.walk = walk_node_safe(g, W, i, S);
             cand.drive = D[i];
         }
-        BusStop* stop = new BusStop((bsid_t)rebuilt.size(), cand.coord, {S[i]->id});
+        BusStop* stop = new BusStop((bsid_t)rebuilt.size(), *cand.coord, {S[i]->id});
         rebuilt.push_back(stop);
         new_sw.push_back(cand.walk);
         new_sd.push_back(cand.drive);
@@ -894,7 +891,7 @@ static void reassign_students(
 
     std::vector<std::vector<std::pair<int, ld>>> options(stu_cnt);
     DistMap walk_dists;
-    const ld search_limit = std::max<ld>(wp.max * 1.5L, wp.max + 25.0L);
+    const ld search_limit = std::max<ld>(wp.max * 1.5, wp.max + 25.0);
     for(size_t i = 0; i < stop_cnt; ++i) {
         node_t source = valid_node(g, sw[i], true);
         if(source < 0) continue;
@@ -947,8 +944,7 @@ static void reassign_students(
         }
         StopCandidate cand = build_cand(members, W, D, S, g, wp);
         if(cand.coord) {
-            delete st[i]->pos;
-            st[i]->pos = cand.coord;
+            st[i]->pos = *cand.coord;
             sw[i] = cand.walk;
             sd[i] = cand.drive;
         }
@@ -969,10 +965,10 @@ static void merge_culdesac_stops(
 ) {
     if(!g || st.size() < 2) return;
     const ld base_limit = std::max<ld>(
-        130.0L,
-        std::min<ld>(std::max<ld>(max_walk * 0.65L, 90.0L), max_walk * 0.95L)
+        130.0,
+        std::min<ld>(std::max<ld>(max_walk * 0.65, 90.0), max_walk * 0.95)
     );
-    const ld relaxed_limit = base_limit * 1.35L;
+    const ld relaxed_limit = base_limit * 1.35;
     bool changed = true;
     while(changed) {
         changed = false;
@@ -998,7 +994,7 @@ static void merge_culdesac_stops(
                     node_t drive_j = valid_node(g, sd[j], false);
                     int deg_j = drive_deg(g, drive_j);
                     if(deg_j <= 1 && deg_i <= 1) continue;
-                    if(deg_j < deg_i && d > limit * 0.7L) continue;
+                    if(deg_j < deg_i && d > limit * 0.7) continue;
                     if(d < best_d - 1e-6 || (std::abs(d - best_d) < 1e-6 && deg_j > best_deg)) {
                         best_d = d;
                         best_j = j;
@@ -1017,7 +1013,6 @@ static void merge_culdesac_stops(
                     st[i]->students.begin(),
                     st[i]->students.end()
                 );
-                delete st[i]->pos;
                 delete st[i];
                 st.erase(st.begin() + i);
                 sw.erase(sw.begin() + i);
@@ -1036,7 +1031,7 @@ static void merge_singleton_stops(
     ld max_walk
 ) {
     if(!g || st.size() < 2) return;
-    const ld limit = std::max<ld>(max_walk * 0.9L, std::min<ld>(max_walk, 260.0L));
+    const ld limit = std::max<ld>(max_walk * 0.9, std::min<ld>(max_walk, 260.0));
     bool merged = true;
     while(merged) {
         merged = false;
@@ -1069,7 +1064,6 @@ static void merge_singleton_stops(
                     st[i]->students.begin(),
                     st[i]->students.end()
                 );
-                delete st[i]->pos;
                 delete st[i];
                 st.erase(st.begin() + i);
                 sw.erase(sw.begin() + i);
@@ -1093,7 +1087,7 @@ vector<BusStop*> run(const vector<Student*>&S,Graph*g,const Params&Pin){
     auto emit=[&](const StopCandidate&c){
         if(!c.coord||c.cover.empty())return;
         vector<sid_t>ids;for(int i:c.cover){ids.push_back(S[i]->id);as[i]=true;}
-        st.push_back(new BusStop((bsid_t)st.size(),c.coord,ids));
+        st.push_back(new BusStop((bsid_t)st.size(),*c.coord,ids));
         sw.push_back(c.walk);sd.push_back(c.drive);
     };
     for(auto&M:clusters){
@@ -1105,7 +1099,7 @@ vector<BusStop*> run(const vector<Student*>&S,Graph*g,const Params&Pin){
         if(!as[i])emit(build_cand({i},W,D,S,g,wp));
     refine(st,sw,sd,S,map,W,D,g,wp,P);
     consolidate_global(st,sw,sd,S,W,D,g,wp,P);
-    merge_close_stops(g, st, sw, sd, std::min<ld>(wp.max * 0.35L, 75.0L));
+    merge_close_stops(g, st, sw, sd, std::min<ld>(wp.max * 0.35, 75.0));
     merge_culdesac_stops(g, st, sw, sd, wp.max);
     merge_singleton_stops(g, st, sw, sd, wp.max);
     reassign_students(st,sw,sd,S,W,D,g,wp,P);
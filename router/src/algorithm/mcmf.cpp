@@ -134,7 +134,7 @@ namespace mcmf {
         cout << "DONE SETUP GRAPH" << endl;
 
         //do mcmf
-        pair<ld, ld> res = mcmf.calc(source, sink);
+        pair<ll, ll> res = mcmf.calc(source, sink);
 
         cout << "DONE MCMF" << endl;
 
@@ -143,7 +143,7 @@ namespace mcmf {
         for(int i = 0; i < N; i++) {
             //find bus that the stop directs most of its flow towards
             int bus = -1;
-            ld most = -INF;
+            ll most = -INF;
             for(int j = 0; j < mcmf.adj[stops[i]].size(); j++) {
                 int e = mcmf.adj[stops[i]][j];
                 MCMF::Edge edge = mcmf.edges[e];
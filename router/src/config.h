@@ -1,3 +1,15 @@
+#pragma once
+
 //If compiling for local testing, set this variable to false
 //If compilig for WASM, set it to true
+//can be overridden at build time with -D_ISWASM=..., as the precision test does
+#ifndef _ISWASM
 #define _ISWASM true
+#endif
+
+//scalar type of coordinates and distances, typedef'd as ld in defs.h. float or double keep edge 
+//weights, csr rows and distance tables at half or a quarter of the size of long double and let 
+//the compiler vectorise loops over them. can be overridden at build time with -D_SCALAR=...
+#ifndef _SCALAR
+#define _SCALAR double
+#endif
@@ -1,11 +1,17 @@
 #pragma once
 #include <math.h>
+#include <type_traits>
 
 #include "json.hpp"
 using json = nlohmann::json;
 
+#include "config.h"
+
 typedef long long ll;
-typedef long double ld;
+
+//scalar used for every coordinate and distance, picked by _SCALAR in config.h
+typedef _SCALAR ld;
+static_assert(std::is_floating_point<ld>::value, "_SCALAR must be float, double or long double");
 
 //earth radius in miles
 #define EARTH_RADIUS_MI 3959.0
@@ -13,4 +19,8 @@ typedef long double ld;
 //earth radius in kilometers
 #define EARTH_RADIUS_KM 6370.0
 
-const ld PI = acos(-1);
\ No newline at end of file
+const ld PI = acos(-1);
+
+//distance of unreachable nodes. compare against this rather than a literal, which need not 
+//survive a round trip through a narrower ld
+const ld DIST_INF = 1e18;
\ No newline at end of file
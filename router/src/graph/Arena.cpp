@@ -0,0 +1,25 @@
+#include "Arena.h"
+
+#include <cstdint>
+#include <algorithm>
+
+Arena::~Arena() {
+    for(auto it = dtors.rbegin(); it != dtors.rend(); it++) it->second(it->first);
+    for(char* b : blocks) ::operator delete(b);
+}
+
+void* Arena::allocate(size_t bytes, size_t align) {
+    uintptr_t at = ((uintptr_t) ptr + align - 1) & ~(uintptr_t) (align - 1);
+    if(ptr == nullptr || at + bytes > (uintptr_t) end) {
+        //oversized objects get a block of their own
+        size_t size = std::max(block_bytes, bytes + align);
+        char* b = (char*) ::operator new(size);
+        blocks.push_back(b);
+        ptr = b;
+        end = b + size;
+        at = ((uintptr_t) ptr + align - 1) & ~(uintptr_t) (align - 1);
+    }
+    ptr = (char*) (at + bytes);
+    used += bytes;
+    return (void*) at;
+}
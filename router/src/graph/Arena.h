@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+//bump allocator for objects that live and die together, like the nodes, edges and coordinates 
+//of one graph. objects are placed back to back in large blocks and destroyed all at once with 
+//the arena, so building a graph costs no allocation per object and freeing it is one pass. 
+//not thread safe, objects are expected to be made while the owner is being built. 
+struct Arena {
+    Arena(size_t _block_bytes = (size_t) 1 << 20) : block_bytes(_block_bytes) {}
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template<class T, class... Args>
+    T* make(Args&&... args) {
+        T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr(!std::is_trivially_destructible_v<T>) {
+            dtors.push_back({obj, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return obj;
+    }
+
+    //bytes handed out so far, not counting block slack
+    size_t bytes_used() const { return used; }
+
+private:
+    size_t block_bytes, used = 0;
+    std::vector<char*> blocks;
+    char* ptr = nullptr;
+    char* end = nullptr;
+
+    //objects that need their destructor run, in creation order
+    std::vector<std::pair<void*, void (*)(void*)>> dtors;
+
+    void* allocate(size_t bytes, size_t align);
+};
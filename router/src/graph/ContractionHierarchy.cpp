@@ -0,0 +1,421 @@
+#include "ContractionHierarchy.h"
+#include "Graph.h"
+
+#include <queue>
+#include <algorithm>
+
+namespace {
+
+const ld INF = DIST_INF;
+
+//witness searches give up after settling this many nodes, a missed witness only costs an extra shortcut
+const int WITNESS_SETTLE_LIMIT = 500;
+const int SIMULATE_SETTLE_LIMIT = 60;
+
+struct DynEdge {
+    int to;
+    ld w;
+    int mid;
+};
+
+//graph that nodes get removed from as they are contracted
+struct DynGraph {
+    std::vector<std::vector<DynEdge>> out, in;
+
+    //local dijkstra scratch, reset through touched
+    std::vector<ld> dist;
+    std::vector<int> touched;
+    std::vector<char> is_target;
+
+    DynGraph(const CSR& g) {
+        int n = g.size();
+        out.resize(n);
+        in.resize(n);
+        dist.assign(n, INF);
+        is_target.assign(n, 0);
+        for(int u = 0; u < n; u++) {
+            for(int k = g.offset[u]; k < g.offset[u + 1]; k++) {
+                int v = g.target[k];
+                if(u == v) continue;
+                add_edge(u, v, g.weight[k], -1);
+            }
+        }
+    }
+
+    //adds u -> v, or lowers the weight of an existing u -> v
+    void add_edge(int u, int v, ld w, int mid) {
+        for(DynEdge& e : out[u]) {
+            if(e.to != v) continue;
+            if(w < e.w) {
+                e.w = w, e.mid = mid;
+                for(DynEdge& r : in[v]) {
+                    if(r.to == u) r.w = w, r.mid = mid;
+                }
+            }
+            return;
+        }
+        out[u].push_back({v, w, mid});
+        in[v].push_back({u, w, mid});
+    }
+
+    //detaches v from the remaining graph
+    void remove(int v) {
+        auto to_v = [&](const DynEdge& e) { return e.to == v; };
+        for(const DynEdge& e : out[v]) {
+            in[e.to].erase(std::remove_if(in[e.to].begin(), in[e.to].end(), to_v), in[e.to].end());
+        }
+        for(const DynEdge& e : in[v]) {
+            out[e.to].erase(std::remove_if(out[e.to].begin(), out[e.to].end(), to_v), out[e.to].end());
+        }
+        std::vector<DynEdge>().swap(out[v]);
+        std::vector<DynEdge>().swap(in[v]);
+    }
+
+    //dijkstra from s avoiding node skip, stops past bound, after settle_limit nodes, 
+    //or once all targets_left nodes marked in is_target are settled
+    void witness_search(int s, int skip, ld bound, int settle_limit, int targets_left) {
+        for(int x : touched) dist[x] = INF;
+        touched.clear();
+        std::priority_queue<std::pair<ld, int>> q;  //{-dist, node}
+        dist[s] = 0;
+        touched.push_back(s);
+        q.push({0, s});
+        int settled = 0;
+        while(q.size()) {
+            ld cdist = -q.top().first;
+            int cur = q.top().second;
+            q.pop();
+            if(cdist != dist[cur]) continue;
+            if(cdist > bound || ++settled > settle_limit) break;
+            if(is_target[cur] && --targets_left == 0) break;
+            for(const DynEdge& e : out[cur]) {
+                if(e.to == skip) continue;
+                ld ndist = cdist + e.w;
+                if(ndist < dist[e.to]) {
+                    if(dist[e.to] == INF) touched.push_back(e.to);
+                    dist[e.to] = ndist;
+                    q.push({-ndist, e.to});
+                }
+            }
+        }
+    }
+
+    //shortcuts needed to contract v. if apply, they are added to the graph
+    int contract(int v, int settle_limit, bool apply) {
+        int cnt = 0;
+        for(const DynEdge& eout : out[v]) is_target[eout.to] = 1;
+        for(const DynEdge& ein : in[v]) {
+            int u = ein.to;
+            ld bound = -1;
+            int targets = 0;
+            for(const DynEdge& eout : out[v]) {
+                if(eout.to == u) continue;
+                bound = std::max(bound, ein.w + eout.w);
+                targets ++;
+            }
+            if(targets == 0) continue;
+            witness_search(u, v, bound, settle_limit, targets + is_target[u]);
+            for(const DynEdge& eout : out[v]) {
+                int w = eout.to;
+                if(w == u) continue;
+                ld via = ein.w + eout.w;
+                if(dist[w] <= via) continue;
+                cnt ++;
+                if(apply) add_edge(u, w, via, v);
+            }
+        }
+        for(const DynEdge& eout : out[v]) is_target[eout.to] = 0;
+        return cnt;
+    }
+};
+
+}
+
+ContractionHierarchy* ContractionHierarchy::build(const CSR& g) {
+    int n = g.size();
+    DynGraph dg(g);
+    std::vector<int> deleted_neighbors(n, 0), level(n, 0);
+
+    auto priority = [&](int v) -> int {
+        int shortcuts = dg.contract(v, SIMULATE_SETTLE_LIMIT, false);
+        int edge_diff = shortcuts - (int) dg.in[v].size() - (int) dg.out[v].size();
+        return 2 * edge_diff + deleted_neighbors[v] + level[v];
+    };
+
+    std::priority_queue<std::pair<int, int>> q;     //{-priority, node}
+    for(int v = 0; v < n; v++) {
+        q.push({-priority(v), v});
+    }
+
+    //edges recorded as nodes get contracted, everything still attached to v ranks above it
+    std::vector<std::vector<DynEdge>> up(n), down(n);
+    std::vector<int> rank(n, -1);
+    int nxt_rank = 0;
+    while(q.size()) {
+        int v = q.top().second;
+        q.pop();
+        if(rank[v] != -1) continue;
+
+        //lazy update, if v got worse since it was pushed try again later
+        int p = priority(v);
+        if(q.size() && p > -q.top().first) {
+            q.push({-p, v});
+            continue;
+        }
+
+        dg.contract(v, WITNESS_SETTLE_LIMIT, true);
+        up[v] = dg.out[v];
+        down[v] = dg.in[v];
+        rank[v] = nxt_rank ++;
+        for(const DynEdge& e : dg.out[v]) {
+            deleted_neighbors[e.to] ++;
+            level[e.to] = std::max(level[e.to], level[v] + 1);
+        }
+        for(const DynEdge& e : dg.in[v]) {
+            deleted_neighbors[e.to] ++;
+            level[e.to] = std::max(level[e.to], level[v] + 1);
+        }
+        dg.remove(v);
+    }
+
+    ContractionHierarchy* ch = new ContractionHierarchy();
+    ch->n = n;
+    ch->rank = rank;
+    ch->up_offset.assign(n + 1, 0);
+    ch->down_offset.assign(n + 1, 0);
+    for(int u = 0; u < n; u++) {
+        ch->up_offset[u + 1] = ch->up_offset[u] + up[u].size();
+        ch->down_offset[u + 1] = ch->down_offset[u] + down[u].size();
+        for(const DynEdge& e : up[u]) {
+            ch->up_target.push_back(e.to);
+            ch->up_weight.push_back(e.w);
+            ch->up_mid.push_back(e.mid);
+        }
+        for(const DynEdge& e : down[u]) {
+            ch->down_source.push_back(e.to);
+            ch->down_weight.push_back(e.w);
+            ch->down_mid.push_back(e.mid);
+        }
+    }
+    return ch;
+}
+
+namespace {
+
+//per thread query state, only the touched entries are reset between queries
+struct QueryScratch {
+    std::vector<ld> dist_f, dist_b;
+    std::vector<int> par_f, par_b;          //parent node in each search tree
+    std::vector<int> par_f_edge, par_b_edge;
+    std::vector<int> touched;
+
+    void ensure(int n) {
+        if((int) dist_f.size() >= n) return;
+        dist_f.assign(n, INF);
+        dist_b.assign(n, INF);
+        par_f.assign(n, -1);
+        par_b.assign(n, -1);
+        par_f_edge.assign(n, -1);
+        par_b_edge.assign(n, -1);
+    }
+
+    void reset() {
+        for(int x : touched) {
+            dist_f[x] = dist_b[x] = INF;
+            par_f[x] = par_b[x] = -1;
+            par_f_edge[x] = par_b_edge[x] = -1;
+        }
+        touched.clear();
+    }
+};
+
+thread_local QueryScratch scratch;
+
+}
+
+int ContractionHierarchy::search(int s, int t, ld& best) const {
+    scratch.ensure(n);
+    scratch.reset();
+
+    std::priority_queue<std::pair<ld, int>> qf, qb;   //{-dist, node}
+    scratch.dist_f[s] = 0;
+    scratch.dist_b[t] = 0;
+    scratch.touched.push_back(s);
+    scratch.touched.push_back(t);
+    qf.push({0, s});
+    qb.push({0, t});
+
+    best = INF;
+    int meet = -1;
+    while(qf.size() || qb.size()) {
+        //once both frontiers are past the best meeting point we are done
+        ld top_f = qf.size() ? -qf.top().first : INF;
+        ld top_b = qb.size() ? -qb.top().first : INF;
+        if(std::min(top_f, top_b) >= best) break;
+
+        bool forward = top_f <= top_b;
+        auto& q = forward ? qf : qb;
+        std::vector<ld>& d = forward ? scratch.dist_f : scratch.dist_b;
+        std::vector<ld>& od = forward ? scratch.dist_b : scratch.dist_f;
+        ld cdist = -q.top().first;
+        int cur = q.top().second;
+        q.pop();
+        if(cdist != d[cur]) continue;
+
+        if(od[cur] != INF && cdist + od[cur] < best) {
+            best = cdist + od[cur];
+            meet = cur;
+        }
+
+        const std::vector<int>& off = forward ? up_offset : down_offset;
+        const std::vector<int>& to = forward ? up_target : down_source;
+        const std::vector<ld>& wt = forward ? up_weight : down_weight;
+        std::vector<int>& par = forward ? scratch.par_f : scratch.par_b;
+        std::vector<int>& par_edge = forward ? scratch.par_f_edge : scratch.par_b_edge;
+        for(int k = off[cur]; k < off[cur + 1]; k++) {
+            int next = to[k];
+            ld ndist = cdist + wt[k];
+            if(ndist < d[next]) {
+                if(scratch.dist_f[next] == INF && scratch.dist_b[next] == INF) scratch.touched.push_back(next);
+                d[next] = ndist;
+                par[next] = cur;
+                par_edge[next] = k;
+                q.push({-ndist, next});
+            }
+        }
+    }
+    return meet;
+}
+
+ld ContractionHierarchy::query(int s, int t) const {
+    if(s == t) return 0;
+    ld dist;
+    search(s, t, dist);
+    return dist;
+}
+
+void ContractionHierarchy::unpack(int u, int v, int mid, std::vector<int>& out) const {
+    //explicit stack of edges still to expand, processed left to right
+    std::vector<std::pair<std::pair<int, int>, int>> stk;  //{{u, v}, mid}
+    stk.push_back({{u, v}, mid});
+    while(stk.size()) {
+        auto [uv, m] = stk.back();
+        stk.pop_back();
+        if(m == -1) {
+            out.push_back(uv.second);
+            continue;
+        }
+
+        //m ranks below both ends, so u -> m is stored at m as a down edge and m -> v as an up edge
+        int left = -1, right = -1;
+        for(int k = down_offset[m]; k < down_offset[m + 1]; k++) {
+            if(down_source[k] == uv.first && (left == -1 || down_weight[k] < down_weight[left])) left = k;
+        }
+        for(int k = up_offset[m]; k < up_offset[m + 1]; k++) {
+            if(up_target[k] == uv.second && (right == -1 || up_weight[k] < up_weight[right])) right = k;
+        }
+        assert(left != -1 && right != -1);
+        stk.push_back({{m, uv.second}, up_mid[right]});
+        stk.push_back({{uv.first, m}, down_mid[left]});
+    }
+}
+
+std::vector<int> ContractionHierarchy::path(int s, int t) const {
+    if(s == t) return {s};
+    ld dist;
+    int meet = search(s, t, dist);
+    if(meet == -1) return {};
+
+    //forward tree gives s .. meet, backward tree gives meet .. t
+    std::vector<int> chain_f;
+    for(int x = meet; x != s; x = scratch.par_f[x]) chain_f.push_back(x);
+    std::reverse(chain_f.begin(), chain_f.end());
+
+    std::vector<int> ret = {s};
+    int prv = s;
+    for(int x : chain_f) {
+        int k = scratch.par_f_edge[x];
+        unpack(prv, x, up_mid[k], ret);
+        prv = x;
+    }
+    for(int x = meet; x != t; ) {
+        int nxt = scratch.par_b[x];
+        int k = scratch.par_b_edge[x];
+        unpack(x, nxt, down_mid[k], ret);
+        x = nxt;
+    }
+    return ret;
+}
+
+void ContractionHierarchy::upward_search(int s, bool forward, std::vector<std::pair<int, ld>>& out) const {
+    scratch.ensure(n);
+    scratch.reset();
+    out.clear();
+
+    const std::vector<int>& off = forward ? up_offset : down_offset;
+    const std::vector<int>& to = forward ? up_target : down_source;
+    const std::vector<ld>& wt = forward ? up_weight : down_weight;
+    std::vector<ld>& d = scratch.dist_f;
+
+    std::priority_queue<std::pair<ld, int>> q;     //{-dist, node}
+    d[s] = 0;
+    scratch.touched.push_back(s);
+    q.push({0, s});
+    while(q.size()) {
+        ld cdist = -q.top().first;
+        int cur = q.top().second;
+        q.pop();
+        if(cdist != d[cur]) continue;
+        out.push_back({cur, cdist});
+        for(int k = off[cur]; k < off[cur + 1]; k++) {
+            int next = to[k];
+            ld ndist = cdist + wt[k];
+            if(ndist < d[next]) {
+                if(d[next] == INF) scratch.touched.push_back(next);
+                d[next] = ndist;
+                q.push({-ndist, next});
+            }
+        }
+    }
+}
+
+std::vector<ld> ContractionHierarchy::many_to_many(const std::vector<int>& sources, const std::vector<int>& targets) const {
+    int S = sources.size(), T = targets.size();
+    std::vector<ld> table((size_t) S * T, INF);
+
+    //every node reached by the backward search from target j gets a bucket entry {j, dist}. 
+    //the searches run in parallel, the buckets are then filled in target order
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<std::vector<std::pair<int, ld>>> settled_b(T);
+    pool.parallel_for(T, [&](int j, int thread) {
+        upward_search(targets[j], false, settled_b[j]);
+    });
+    std::vector<std::vector<std::pair<int, ld>>> buckets(n);
+    for(int j = 0; j < T; j++) {
+        for(auto [x, d] : settled_b[j]) {
+            buckets[x].push_back({j, d});
+        }
+    }
+    settled_b.clear();
+
+    //the forward search from source i meets every target's search at the top of the path
+    std::vector<std::vector<std::pair<int, ld>>> settled_f(pool.size());
+    pool.parallel_for(S, [&](int i, int thread) {
+        ld* row = &table[(size_t) i * T];
+        std::vector<std::pair<int, ld>>& settled = settled_f[thread];
+        upward_search(sources[i], true, settled);
+        for(auto [x, d] : settled) {
+            for(auto [j, db] : buckets[x]) {
+                row[j] = std::min(row[j], d + db);
+            }
+        }
+    });
+    return table;
+}
+
+size_t ContractionHierarchy::nr_shortcuts() const {
+    size_t cnt = 0;
+    for(int m : up_mid) cnt += (m != -1);
+    for(int m : down_mid) cnt += (m != -1);
+    return cnt;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+#include "../defs.h"
+
+struct CSR;
+
+//contraction hierarchy over a single travel mode.
+//nodes are contracted one at a time in order of importance, adding shortcut edges so that
+//shortest path distances among the remaining nodes are preserved. a point to point query
+//is then a bidirectional dijkstra that only ever moves up the hierarchy, which settles a
+//few hundred nodes instead of the whole graph.
+struct ContractionHierarchy {
+    int n;
+
+    //rank[u] is the position of u in the contraction order
+    std::vector<int> rank;
+
+    //upward edges u -> v with rank[v] > rank[u], stored at u.
+    //mid is the contracted node a shortcut skips over, or -1 for an original edge
+    std::vector<int> up_offset, up_target, up_mid;
+    std::vector<ld> up_weight;
+
+    //upward edges of the reversed graph: u -> v with rank[u] > rank[v], stored at v
+    std::vector<int> down_offset, down_source, down_mid;
+    std::vector<ld> down_weight;
+
+    ContractionHierarchy() { n = 0; }
+
+    //contracts every node of g
+    static ContractionHierarchy* build(const CSR& g);
+
+    //shortest distance from s to t, DIST_INF if t is unreachable
+    ld query(int s, int t) const;
+
+    //nodes on the shortest path from s to t including both ends, empty if t is unreachable
+    std::vector<int> path(int s, int t) const;
+
+    //bucket based many to many distances, row major sources.size() x targets.size()
+    std::vector<ld> many_to_many(const std::vector<int>& sources, const std::vector<int>& targets) const;
+
+    size_t nr_shortcuts() const;
+
+private:
+    //runs the bidirectional upward search, returns the node where the two searches meet or -1.
+    //the search trees are left in this thread's scratch space for path() to read
+    int search(int s, int t, ld& dist) const;
+
+    //plain dijkstra from s over the upward (forward) or reversed upward (backward) edges, 
+    //returns every settled node with its distance
+    void upward_search(int s, bool forward, std::vector<std::pair<int, ld>>& out) const;
+
+    //appends the original nodes of edge u -> v (excluding u) to out
+    void unpack(int u, int v, int mid, std::vector<int>& out) const;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+
+#include "../defs.h"
+#include "Graph.h"
+#include "Heap.h"
+
+//the one dijkstra behind every one-to-many search: full sssp rows, distance tables, dbscan's
+//bounded walks and the stop scoring in BRP. the travel mode is fixed by which CSR is passed in,
+//walk_csr and drive_csr only hold the edges usable in their mode, so the edge loop never tests it.
+
+//grows a search from root over g without going past cut. visit(u, dist) is called when u is popped
+//at its current distance and returns true once the caller has all it needs. heaps with SLACK > 0
+//pop slightly out of order, so u may be visited again with a smaller distance, and the search goes
+//on for SLACK after visit first asks to stop so that nothing already visited can still improve.
+//d must be DIST_INF for every node not in touched, reached nodes are appended to touched.
+//if prev is given it must be -1 for every node not in touched and gets the search tree.
+template<class Heap, class Visit>
+void dijkstra(const CSR& g, int root, ld cut, std::vector<ld>& d, std::vector<int>& touched, std::vector<int>* prev, Visit visit) {
+    thread_local Heap q;
+    q.clear();
+    d[root] = 0;
+    touched.push_back(root);
+    q.push(0, root);
+    ld stop_at = DIST_INF;
+    while(!q.empty()) {
+        auto [cdist, cur] = q.pop();
+        if(cdist >= stop_at) break;
+        if(d[cur] != cdist) continue;
+        if(visit(cur, cdist) && stop_at == DIST_INF) {
+            if(Heap::SLACK == 0) break;
+            stop_at = cdist + Heap::SLACK;
+        }
+        for(int k = g.offset[cur]; k < g.offset[cur + 1]; k++) {
+            ld ndist = cdist + g.weight[k];
+            int next = g.target[k];
+            if(ndist < d[next] && ndist <= cut) {
+                if(d[next] == DIST_INF) touched.push_back(next);
+                d[next] = ndist;
+                if(prev != nullptr) (*prev)[next] = cur;
+                q.push(ndist, next);
+            }
+        }
+    }
+}
+
+//same, with the heap picked by Graph::use_radix_heap
+template<class Visit>
+void dijkstra(const CSR& g, int root, ld cut, std::vector<ld>& d, std::vector<int>& touched, std::vector<int>* prev, Visit visit) {
+    if(Graph::use_radix_heap) dijkstra<RadixHeap>(g, root, cut, d, touched, prev, visit);
+    else dijkstra<BinaryHeap>(g, root, cut, d, touched, prev, visit);
+}
+
+//working arrays for repeated bounded searches, reset through touched so that a search
+//costs what it explores rather than O(n)
+struct SearchScratch {
+    std::vector<ld> d;
+    std::vector<int> touched;
+
+    //sizes d for a graph of n nodes and clears what the last search reached
+    void reset(int n) {
+        if((int) d.size() != n) {
+            d.assign(n, DIST_INF);
+            touched.clear();
+            return;
+        }
+        for(int x : touched) d[x] = DIST_INF;
+        touched.clear();
+    }
+};
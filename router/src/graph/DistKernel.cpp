@@ -0,0 +1,55 @@
+#include "DistKernel.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+    #include <wasm_simd128.h>
+#endif
+
+void chord_sq_dists(const double* q, const double* x, const double* y, const double* z, int count, double* out) {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256d qx = _mm256_set1_pd(q[0]), qy = _mm256_set1_pd(q[1]), qz = _mm256_set1_pd(q[2]);
+    for(; i + 4 <= count; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), qx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), qy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), qz);
+        __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        _mm256_storeu_pd(out + i, d);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128d qx = _mm_set1_pd(q[0]), qy = _mm_set1_pd(q[1]), qz = _mm_set1_pd(q[2]);
+    for(; i + 2 <= count; i += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), qx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), qy);
+        __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), qz);
+        __m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        _mm_storeu_pd(out + i, d);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t qx = vdupq_n_f64(q[0]), qy = vdupq_n_f64(q[1]), qz = vdupq_n_f64(q[2]);
+    for(; i + 2 <= count; i += 2) {
+        float64x2_t dx = vsubq_f64(vld1q_f64(x + i), qx);
+        float64x2_t dy = vsubq_f64(vld1q_f64(y + i), qy);
+        float64x2_t dz = vsubq_f64(vld1q_f64(z + i), qz);
+        float64x2_t d = vaddq_f64(vaddq_f64(vmulq_f64(dx, dx), vmulq_f64(dy, dy)), vmulq_f64(dz, dz));
+        vst1q_f64(out + i, d);
+    }
+#elif defined(__wasm_simd128__)
+    v128_t qx = wasm_f64x2_splat(q[0]), qy = wasm_f64x2_splat(q[1]), qz = wasm_f64x2_splat(q[2]);
+    for(; i + 2 <= count; i += 2) {
+        v128_t dx = wasm_f64x2_sub(wasm_v128_load(x + i), qx);
+        v128_t dy = wasm_f64x2_sub(wasm_v128_load(y + i), qy);
+        v128_t dz = wasm_f64x2_sub(wasm_v128_load(z + i), qz);
+        v128_t d = wasm_f64x2_add(wasm_f64x2_add(wasm_f64x2_mul(dx, dx), wasm_f64x2_mul(dy, dy)), wasm_f64x2_mul(dz, dz));
+        wasm_v128_store(out + i, d);
+    }
+#endif
+    //whatever the vector loop left over, or everything without simd. same operation order as the lanes above
+    for(; i < count; i++) {
+        double dx = x[i] - q[0], dy = y[i] - q[1], dz = z[i] - q[2];
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+//distance kernels over contiguous blocks of points, vectorised with whatever the target offers
+//(AVX2, SSE2, NEON or WASM SIMD) and plain loops otherwise.
+
+//squared straight line distances from q to the count points (x[i], y[i], z[i]), written to out.
+//for points projected onto the unit sphere this orders them by great circle distance from q
+void chord_sq_dists(const double* q, const double* x, const double* y, const double* z, int count, double* out);
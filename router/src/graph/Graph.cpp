@@ -1,16 +1,32 @@
 #include "Graph.h"
+#include "Dijkstra.h"
+#include "OSMParser.h"
+
+bool Graph::use_radix_heap = false;
+bool Graph::contract_chains_on_parse = true;
+bool Graph::reorder_nodes_on_parse = true;
+bool Graph::prune_fragments_on_parse = true;
+int Graph::nr_landmarks = 16;
+bool Graph::cache_rows = false;
+bool Graph::use_ch = true;
 
 ld deg_to_rad(ld d) {
-    return d * (PI / 180.0L);
+    return d * (PI / 180.0);
 }
 
-//use haversine formula to compute geodesics
+//use haversine formula to compute geodesics. written with sin^2(x / 2) rather than 1 - cos(x), 
+//which cancels to 0 for nearby points when ld is float
 ld calc_dist(Coordinate* a, Coordinate* b) {
-    ld dlat = b->lat - a->lat;
-    ld dlon = b->lon - a->lon;
-    ld inner = 1.0 - cos(deg_to_rad(dlat)) + cos(deg_to_rad(a->lat)) * cos(deg_to_rad(b->lat)) * (1.0 - cos(deg_to_rad(dlon)));
-    // return 2.0 * EARTH_RADIUS_MI * asin(sqrt(inner / 2.0));
-    return 2.0 * (1000 * EARTH_RADIUS_KM) * asin(sqrt(inner / 2.0));
+    ld sdlat = sin(deg_to_rad(b->lat - a->lat) / 2);
+    ld sdlon = sin(deg_to_rad(b->lon - a->lon) / 2);
+    ld inner = sdlat * sdlat + cos(deg_to_rad(a->lat)) * cos(deg_to_rad(b->lat)) * sdlon * sdlon;
+    // return 2.0 * EARTH_RADIUS_MI * asin(sqrt(inner));
+    return 2.0 * (1000 * EARTH_RADIUS_KM) * asin(sqrt(inner));
+}
+
+//Coordinate::parse, but placed in arena
+Coordinate* parse_coord(json& j, Arena& arena) {
+    return arena.make<Coordinate>(Coordinate::parse(j));
 }
 
 OSMNode* OSMNode::parse(json& j) {
@@ -28,30 +44,29 @@ OSMWay* OSMWay::parse(json& j) {
     assert(j["nodes"].is_array());
     for(ll x : j["nodes"]) node_ids.push_back(x);
     assert(j.contains("tags"));
-    return new OSMWay(id, node_ids, j["tags"]);
+    WayTags tags;
+    for(auto& [key, value] : j["tags"].items()) {
+        if(value.is_string()) tags.set(key, value.get_ref<const std::string&>());
+    }
+    return new OSMWay(id, node_ids, tags);
 }
 
 bool OSMWay::is_driveable() {
-    std::string hw = tags.contains("highway") ? tags["highway"] : "";
-    std::string access = tags.contains("access") ? tags["access"] : "";
-    std::string mv = tags.contains("motor_vehicle") ? tags["motor_vehicle"] : "";
-    std::string mc = tags.contains("motorcar") ? tags["motorcar"] : "";
-    std::string veh = tags.contains("vehicle") ? tags["vehicle"] : "";
-
-    if (hw.empty()) return false;
-    if (hw == "construction" || hw == "proposed") return false;
+    if (tags.highway == WayTags::HW_NONE) return false;
+    if (tags.highway == WayTags::HW_CONSTRUCTION || tags.highway == WayTags::HW_PROPOSED) return false;
 
     // reject non-car ways unless explicitly allowed
-    if (hw == "footway" || hw == "path" || hw == "pedestrian" || hw == "steps" ||
-        hw == "bridleway" || hw == "cycleway" || hw == "corridor")
-        return (mv == "yes" || mc == "yes" || veh == "yes");
+    if (tags.highway == WayTags::HW_FOOTWAY || tags.highway == WayTags::HW_PATH || tags.highway == WayTags::HW_PEDESTRIAN || 
+        tags.highway == WayTags::HW_STEPS || tags.highway == WayTags::HW_BRIDLEWAY || tags.highway == WayTags::HW_CYCLEWAY || 
+        tags.highway == WayTags::HW_CORRIDOR)
+        return (tags.motor_vehicle == WayTags::ACCESS_YES || tags.motorcar == WayTags::ACCESS_YES || tags.vehicle == WayTags::ACCESS_YES);
 
     //TODO consider some more stuff
     // Tracks: allow but might weight heavily. 
     // Service roads: also weight heavily. 
 
     // explicitly non-driveable
-    if (mv == "no" || mc == "no" || veh == "no") return false;
+    if (tags.motor_vehicle == WayTags::ACCESS_NO || tags.motorcar == WayTags::ACCESS_NO || tags.vehicle == WayTags::ACCESS_NO) return false;
 
     return true;
 }
@@ -98,37 +113,29 @@ bool OSMWay::is_driveable() {
 
 //extremely lenient definition of walkable
 bool OSMWay::is_walkable() {
-    std::string hw = tags.contains("highway") ? tags["highway"] : "";
-    std::string access = tags.contains("access") ? tags["access"] : "";
-    std::string foot = tags.contains("foot") ? tags["foot"] : "";
-
-    if (hw.empty()) return false;
-    if (hw == "construction" || hw == "proposed") return false;
+    if (tags.highway == WayTags::HW_NONE) return false;
+    if (tags.highway == WayTags::HW_CONSTRUCTION || tags.highway == WayTags::HW_PROPOSED) return false;
 
     // is footpath explicitly blocked
-    if (foot == "no") return false;
+    if (tags.foot == WayTags::ACCESS_NO) return false;
 
     return true;
 }
 
 int OSMWay::drive_dir() {
-    std::string ow = tags.contains("oneway") ? tags["oneway"] : "";
-
     // explicit direction controls
-    if (ow == "yes" || ow == "true" || ow == "1") return 1;
-    if (ow == "-1") return -1;
-    if (ow == "no" || ow == "false" || ow == "0") return 0;
+    if (tags.oneway == WayTags::DIR_FORWARD) return 1;
+    if (tags.oneway == WayTags::DIR_BACKWARD) return -1;
+    if (tags.oneway == WayTags::DIR_BOTH) return 0;
 
     // roundabouts are one way forward
-    std::string junc = tags.contains("junction") ? tags["junction"] : "";
-    if (junc == "roundabout" || junc == "circular") return 1;
+    if (tags.roundabout) return 1;
 
     // motorways are forwards
-    std::string hw = tags.contains("highway") ? tags["highway"] : "";
-    if (hw == "motorway") return 1;
+    if (tags.highway == WayTags::HW_MOTORWAY) return 1;
 
     // ramp/connector to motorway should be one way
-    if (hw.size() > 5 && hw.rfind("_link") == hw.size() - 5) return 1;
+    if (tags.highway_link) return 1;
 
     // default
     return 0;
@@ -136,32 +143,29 @@ int OSMWay::drive_dir() {
 
 int OSMWay::walk_dir() {
     // footpath direction typically ignores vehicle direction
-    std::string owf = tags.contains("oneway:foot") ? tags["oneway:foot"] : "";
-    
     // explicit direction controls
-    if (owf == "yes" || owf == "true" || owf == "1") return 1;
-    if (owf == "-1") return -1;
-    if (owf == "no" || owf == "false" || owf == "0") return 0;
+    if (tags.oneway_foot == WayTags::DIR_FORWARD) return 1;
+    if (tags.oneway_foot == WayTags::DIR_BACKWARD) return -1;
+    if (tags.oneway_foot == WayTags::DIR_BOTH) return 0;
 
     // escalators/travelators
-    std::string conveying = tags.contains("conveying") ? tags["conveying"] : "";
-    if (conveying == "forward")  return 1;
-    if (conveying == "backward") return -1;
+    if (tags.conveying == WayTags::DIR_FORWARD) return 1;
+    if (tags.conveying == WayTags::DIR_BACKWARD) return -1;
 
     // default
     return 0;
 }
 
-Node* Node::parse(json& j) {
+Node* Node::parse(json& j, Arena& arena) {
     if(!j.contains("id")) throw std::runtime_error("Node missing id");
     if(!j.contains("coord")) throw std::runtime_error("Node missing coord");
     if(!j.contains("is_walkable")) throw std::runtime_error("Node missing is_walkable");
     if(!j.contains("is_driveable")) throw std::runtime_error("Node missing is_driveable");
     ll id = j["id"];
-    Coordinate *coord = Coordinate::parse(j["coord"]);
+    Coordinate *coord = parse_coord(j["coord"], arena);
     bool is_walkable = j["is_walkable"];
     bool is_driveable = j["is_driveable"];
-    return new Node(id, coord, is_walkable, is_driveable);
+    return arena.make<Node>(id, coord, is_walkable, is_driveable);
 }
 
 json Node::to_json() {
@@ -173,11 +177,11 @@ json Node::to_json() {
     return ret;
 }   
 
-Node* Node::make_copy() {
-    return new Node(id, coord->make_copy(), is_walkable, is_driveable);
+Node* Node::make_copy(Arena& arena) {
+    return arena.make<Node>(id, arena.make<Coordinate>(*coord), is_walkable, is_driveable);
 }
 
-Edge* Edge::parse(json& j) {
+Edge* Edge::parse(json& j, Arena& arena) {
     if(!j.contains("u")) throw std::runtime_error("Edge missing u");
     if(!j.contains("v")) throw std::runtime_error("Edge missing v");
     if(!j.contains("dist")) throw std::runtime_error("Edge missing dist");
@@ -188,7 +192,14 @@ Edge* Edge::parse(json& j) {
     ld dist = j["dist"], speed_limit = j["speed_limit"];
     bool is_walkable = j["is_walkable"];
     bool is_driveable = j["is_driveable"];
-    return new Edge(u, v, dist, speed_limit, is_driveable, is_walkable);
+    Edge* e = arena.make<Edge>(u, v, dist, speed_limit, is_driveable, is_walkable);
+    if(j.contains("geometry")) {
+        if(!j["geometry"].is_array()) throw std::runtime_error("Edge geometry malformed (not an array)");
+        for(int i = 0; i < j["geometry"].size(); i++) {
+            e->geometry.push_back(parse_coord(j["geometry"][i], arena));
+        }
+    }
+    return e;
 }
 
 json Edge::to_json() {
@@ -199,127 +210,283 @@ json Edge::to_json() {
     ret["speed_limit"] = speed_limit;
     ret["is_walkable"] = is_walkable;
     ret["is_driveable"] = is_driveable;
+    if(geometry.size()) {
+        std::vector<json> geometry_json;
+        for(Coordinate* c : geometry) geometry_json.push_back(c->to_json());
+        ret["geometry"] = geometry_json;
+    }
     return ret;
 }
 
-Edge* Edge::make_copy() {
-    return new Edge(u, v, dist, speed_limit, is_driveable, is_walkable);
+Edge* Edge::make_copy(Arena& arena) {
+    Edge* e = arena.make<Edge>(u, v, dist, speed_limit, is_driveable, is_walkable);
+    for(Coordinate* c : geometry) e->geometry.push_back(arena.make<Coordinate>(*c));
+    return e;
+}
+
+CSR::CSR(const std::vector<std::vector<Edge*>>& adj, bool walkable) {
+    int n = adj.size();
+    offset.assign(n + 1, 0);
+    for(int i = 0; i < n; i++) {
+        int deg = 0;
+        for(Edge* e : adj[i]) {
+            if(walkable ? e->is_walkable : e->is_driveable) deg ++;
+        }
+        offset[i + 1] = offset[i] + deg;
+    }
+    target.resize(offset[n]);
+    weight.resize(offset[n]);
+    for(int i = 0; i < n; i++) {
+        int ptr = offset[i];
+        for(Edge* e : adj[i]) {
+            if(!(walkable ? e->is_walkable : e->is_driveable)) continue;
+            target[ptr] = e->v;
+            weight[ptr] = e->dist;
+            ptr ++;
+        }
+    }
+}
+
+CSR CSR::transpose() const {
+    int n = size();
+    CSR r;
+    r.offset.assign(n + 1, 0);
+    for(int k = 0; k < (int) target.size(); k++) r.offset[target[k] + 1] ++;
+    for(int i = 0; i < n; i++) r.offset[i + 1] += r.offset[i];
+    r.target.resize(target.size());
+    r.weight.resize(weight.size());
+    std::vector<int> ptr(r.offset.begin(), r.offset.end() - 1);
+    for(int u = 0; u < n; u++) {
+        for(int k = offset[u]; k < offset[u + 1]; k++) {
+            int at = ptr[target[k]] ++;
+            r.target[at] = u;
+            r.weight[at] = weight[k];
+        }
+    }
+    return r;
 }
 
 Graph* Graph::parse_osm(json& j) {
-    std::map<ll, OSMNode*> osm_nodes;
-    std::map<ll, OSMWay*> osm_ways;
+    OSMGraphBuilder builder;
     for(auto& [key, value] : j["elements"].items()) {
         assert(value.is_object());
         assert(value.contains("type"));
         std::string type = value["type"];
         if(type == "node") {
             OSMNode* node = OSMNode::parse(value);
-            osm_nodes.insert({node->id, node});
+            builder.add_node(node->id, node->coord.lat, node->coord.lon);
+            delete node;
         }
         else if(type == "way") {
-            OSMWay* way = OSMWay::parse(value);
-            osm_ways.insert({way->id, way});
+            builder.add_way(OSMWay::parse(value));
         }
         else assert(false);
     }
+    return builder.build();
+}
 
-    //turn OSMNodes into nodes
-    int n = osm_nodes.size();
-    std::vector<Node*> nodes;
-    std::map<ll, ll> node_inds;
-    {   
-        ll ptr = 0;
-        for(auto i = osm_nodes.begin(); i != osm_nodes.end(); i++) {
-            ll id = i->first;
-            OSMNode *node = i->second;
-            assert(node_inds.count(id) == 0);
-            node_inds.insert({id, ptr});
-            nodes.push_back(new Node(nodes.size(), new Coordinate(node->coord->lat, node->coord->lon)));
-            ptr ++;
+Graph* Graph::parse_osm(std::istream& in, std::string* remark) {
+    OSMGraphBuilder builder;
+    parse_overpass_stream(in, builder, remark);
+    return builder.build();
+}
+
+void Graph::contract_chains() {
+    int n = nodes.size();
+    auto live = [](Edge* e) { return e->is_walkable || e->is_driveable; };
+
+    //only keep edges usable in some mode, and index them by head as well
+    std::vector<std::vector<Edge*>> in(n);
+    for(int u = 0; u < n; u++) {
+        std::vector<Edge*> out;
+        for(Edge* e : adj[u]) {
+            if(!live(e)) continue;
+            out.push_back(e);
+            in[e->v].push_back(e);
         }
+        adj[u] = out;
+    }
+    auto erase = [](std::vector<Edge*>& list, Edge* e) {
+        list.erase(std::find(list.begin(), list.end(), e));
+    };
+    auto same_kind = [](Edge* a, Edge* b) {
+        return a->is_walkable == b->is_walkable && a->is_driveable == b->is_driveable && a->speed_limit == b->speed_limit;
+    };
+
+    std::vector<bool> removed(n, false);
+    for(int v = 0; v < n; v++) {
+        //v must touch exactly two other nodes a and b, with at most one edge per direction to each
+        std::vector<ll> nbr;
+        for(Edge* e : adj[v]) nbr.push_back(e->v);
+        for(Edge* e : in[v]) nbr.push_back(e->u);
+        std::sort(nbr.begin(), nbr.end());
+        nbr.erase(std::unique(nbr.begin(), nbr.end()), nbr.end());
+        if(nbr.size() != 2 || nbr[0] == v || nbr[1] == v) continue;
+        if(adj[v].size() > 2 || in[v].size() > 2) continue;
+        ll a = nbr[0];
+        Edge *in_a = nullptr, *in_b = nullptr, *out_a = nullptr, *out_b = nullptr;
+        bool dup = false;
+        for(Edge* e : in[v]) {
+            Edge*& slot = e->u == a ? in_a : in_b;
+            dup |= slot != nullptr;
+            slot = e;
+        }
+        for(Edge* e : adj[v]) {
+            Edge*& slot = e->v == a ? out_a : out_b;
+            dup |= slot != nullptr;
+            slot = e;
+        }
+        if(dup) continue;
+
+        //a -> v -> b and b -> v -> a must each be either absent or two edges of the same kind, 
+        //otherwise v is where something about the road changes
+        if((in_a == nullptr) != (out_b == nullptr) || (in_b == nullptr) != (out_a == nullptr)) continue;
+        if(in_a != nullptr && !same_kind(in_a, out_b)) continue;
+        if(in_b != nullptr && !same_kind(in_b, out_a)) continue;
+
+        auto merge = [&](Edge* e1, Edge* e2) {
+            Edge* e = arena.make<Edge>(e1->u, e2->v, e1->dist + e2->dist, e1->speed_limit, e1->is_driveable, e1->is_walkable);
+            e->geometry = e1->geometry;
+            e->geometry.push_back(nodes[v]->coord);
+            e->geometry.insert(e->geometry.end(), e2->geometry.begin(), e2->geometry.end());
+            erase(adj[e1->u], e1);
+            erase(in[e2->v], e2);
+            adj[e->u].push_back(e);
+            in[e->v].push_back(e);
+        };
+        if(in_a != nullptr) merge(in_a, out_b);
+        if(in_b != nullptr) merge(in_b, out_a);
+        adj[v].clear();
+        in[v].clear();
+        removed[v] = true;
     }
 
-    //turn OSMWays into edges
-    std::vector<std::vector<Edge*>> adj(n);
-    for(auto iter = osm_ways.begin(); iter != osm_ways.end(); iter++) {
-        OSMWay *way = iter->second;
-        if(way->node_ids.size() < 2) continue;  //check for degenerate ways
-
-        bool is_driveable = way->is_driveable();
-        bool is_walkable = way->is_walkable();
-        int drive_dir = way->drive_dir();
-        int walk_dir = way->walk_dir();
-
-        bool is_driveable_forward = is_driveable && (drive_dir >= 0);
-        bool is_driveable_backward = is_driveable && (drive_dir <= 0);
-        bool is_walkable_forward = is_walkable && (walk_dir >= 0);
-        bool is_walkable_backward = is_walkable && (walk_dir <= 0);
-
-        ll prev = way->node_ids[0];
-        for(int i = 1; i < way->node_ids.size(); i++) {
-            ll next = way->node_ids[i];
-            ll u = node_inds.at(prev), v = node_inds.at(next);
-
-            //add edges
-            Edge *e1 = new Edge(u, v, calc_dist(nodes[u]->coord, nodes[v]->coord), -1, is_driveable_forward, is_walkable_forward);
-            adj[u].push_back(e1);
-            Edge *e2 = new Edge(v, u, calc_dist(nodes[u]->coord, nodes[v]->coord), -1, is_driveable_backward, is_walkable_backward);
-            adj[v].push_back(e2);
-            
-            //upd node walkable/driveable status
-            nodes[u]->is_driveable |= is_driveable_forward;
-            nodes[v]->is_driveable |= is_driveable_backward;
-            nodes[u]->is_walkable |= is_walkable_forward;
-            nodes[v]->is_walkable |= is_walkable_backward;
-
-            prev = next;
+    //renumber the nodes that are left, dropping ones without edges
+    std::vector<int> new_ind(n, -1);
+    int m = 0;
+    for(int v = 0; v < n; v++) {
+        if(removed[v] || (adj[v].size() == 0 && in[v].size() == 0)) continue;
+        new_ind[v] = m ++;
+    }
+    renumber(new_ind);
+    std::cout << "CONTRACTED CHAINS : " << n << " -> " << m << " nodes" << std::endl;
+}
+
+void Graph::prune_fragments() {
+    int n = nodes.size();
+    Components walk(CSR(adj, true)), drive(CSR(adj, false));
+
+    //an edge keeps a mode only if both its ends are in that mode's main component, 
+    //nodes are left with the modes of their remaining outgoing edges
+    std::vector<bool> keep(n, false);
+    for(int u = 0; u < n; u++) {
+        nodes[u]->is_walkable = nodes[u]->is_driveable = false;
+        std::vector<Edge*> out;
+        for(Edge* e : adj[u]) {
+            e->is_walkable = e->is_walkable && walk.in_main(e->u) && walk.in_main(e->v);
+            e->is_driveable = e->is_driveable && drive.in_main(e->u) && drive.in_main(e->v);
+            if(!e->is_walkable && !e->is_driveable) continue;
+            nodes[u]->is_walkable = nodes[u]->is_walkable || e->is_walkable;
+            nodes[u]->is_driveable = nodes[u]->is_driveable || e->is_driveable;
+            keep[e->u] = keep[e->v] = true;
+            out.push_back(e);
         }
+        adj[u] = out;
     }
 
-    Graph *g = new Graph();
-    g->nodes = nodes;
-    g->adj = adj;
-    g->dist_walk = std::vector<std::vector<ld>>(nodes.size());
-    g->dist_drive = std::vector<std::vector<ld>>(nodes.size());
-    g->prev_walk = std::vector<std::vector<int>>(nodes.size());
-    g->prev_drive = std::vector<std::vector<int>>(nodes.size());
+    std::vector<int> new_ind(n, -1);
+    int m = 0;
+    for(int u = 0; u < n; u++) {
+        if(keep[u]) new_ind[u] = m ++;
+    }
+    renumber(new_ind);
+    std::cout << "PRUNED FRAGMENTS : " << n << " -> " << m << " nodes" << std::endl;
+}
 
-    return g;
+void Graph::renumber(const std::vector<int>& new_ind) {
+    int n = nodes.size(), m = 0;
+    for(int x : new_ind) m += x != -1;
+    std::vector<Node*> _nodes(m);
+    std::vector<std::vector<Edge*>> _adj(m);
+    for(int u = 0; u < n; u++) {
+        if(new_ind[u] == -1) continue;
+        nodes[u]->id = new_ind[u];
+        _nodes[new_ind[u]] = nodes[u];
+        for(Edge* e : adj[u]) {
+            e->u = new_ind[e->u];
+            e->v = new_ind[e->v];
+        }
+        _adj[new_ind[u]] = std::move(adj[u]);
+    }
+    nodes = std::move(_nodes);
+    adj = std::move(_adj);
+}
+
+//position of cell (x, y) along the hilbert curve filling a 2^16 x 2^16 grid
+static uint64_t hilbert_index(uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for(uint32_t s = 1u << 15; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+        //rotate the quadrant so the curve stays continuous
+        if(ry == 0) {
+            if(rx == 1) {
+                x = 65535 - x;
+                y = 65535 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void Graph::reorder_nodes() {
+    int n = nodes.size();
+    if(n == 0) return;
+    ld min_lat = nodes[0]->coord->lat, max_lat = min_lat;
+    ld min_lon = nodes[0]->coord->lon, max_lon = min_lon;
+    for(Node* x : nodes) {
+        min_lat = std::min(min_lat, x->coord->lat), max_lat = std::max(max_lat, x->coord->lat);
+        min_lon = std::min(min_lon, x->coord->lon), max_lon = std::max(max_lon, x->coord->lon);
+    }
+
+    //snap every node onto the hilbert grid over the bounding box and sort by curve position, 
+    //ties keep the old order
+    auto cell = [](ld v, ld lo, ld hi) {
+        if(hi <= lo) return (uint32_t) 0;
+        ld t = (v - lo) / (hi - lo) * 65535;
+        return (uint32_t) std::min<ld>(std::max<ld>(t, 0), 65535);
+    };
+    std::vector<uint64_t> key(n);
+    for(int i = 0; i < n; i++) {
+        key[i] = hilbert_index(cell(nodes[i]->coord->lon, min_lon, max_lon), cell(nodes[i]->coord->lat, min_lat, max_lat));
+    }
+    std::vector<int> order(n), new_ind(n);
+    for(int i = 0; i < n; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return key[a] < key[b]; });
+    for(int i = 0; i < n; i++) new_ind[order[i]] = i;
+    renumber(new_ind);
 }
 
 Graph* Graph::parse(json& j) {
     if(!j.contains("nodes")) throw std::runtime_error("Graph missing nodes");
     if(!j.contains("adj")) throw std::runtime_error("Graph missing edges");
-    if(!j.contains("dist_walk")) throw std::runtime_error("Graph missing dist_walk");
-    if(!j.contains("dist_drive")) throw std::runtime_error("Graph missing dist_drive");
-    if(!j.contains("prev_walk")) throw std::runtime_error("Graph missing prev_walk");
-    if(!j.contains("prev_drive")) throw std::runtime_error("Graph missing prev_drive");
+    Graph* g = new Graph();
     std::vector<Node*> nodes;
     for(int i = 0; i < j["nodes"].size(); i++) {
-        nodes.push_back(Node::parse(j["nodes"][i]));
+        nodes.push_back(Node::parse(j["nodes"][i], g->arena));
     }
     int n = nodes.size();
     std::vector<std::vector<Edge*>> adj(n);
     for(int i = 0; i < j["adj"].size(); i++) {
         for(int k = 0; k < j["adj"][i].size(); k++) {
-            adj[i].push_back(Edge::parse(j["adj"][i][k]));
+            adj[i].push_back(Edge::parse(j["adj"][i][k], g->arena));
         }
     }
-    std::vector<std::vector<ld>> dist_walk, dist_drive;
-    std::vector<std::vector<int>> prev_walk, prev_drive;
-    dist_walk = j["dist_walk"];
-    dist_drive = j["dist_drive"];
-    prev_walk = j["prev_walk"];
-    prev_drive = j["prev_drive"];
 
     //some checks
     if(adj.size() != n) throw std::runtime_error("Graph adj must be of size n");
-    if(dist_walk.size() != n) throw std::runtime_error("Graph dist_walk must be of size n");
-    if(dist_drive.size() != n) throw std::runtime_error("Graph dist_drive must be of size n");
-    if(prev_walk.size() != n) throw std::runtime_error("Graph prev_walk must be of size n");
-    if(prev_drive.size() != n) throw std::runtime_error("Graph prev_drive must be of size n");
-    
     for(int i = 0; i < n; i++) {
         if(nodes[i]->id != i) throw std::runtime_error("Graph node id must match ind");
     }
@@ -328,20 +495,28 @@ Graph* Graph::parse(json& j) {
             if(adj[i][k]->u != i) throw std::runtime_error("Graph edge u must match ind");
         }
     }   
-    for(int i = 0; i < n; i++) {
-        if(dist_walk[i].size() != 0 && dist_walk[i].size() != n) throw std::runtime_error("Graph dist_walk must be either populated or not populated");
-        if(dist_drive[i].size() != 0 && dist_drive[i].size() != n) throw std::runtime_error("Graph dist_drive must be either populated or not populated");
-        if(prev_walk[i].size() != 0 && prev_walk[i].size() != n) throw std::runtime_error("Graph prev_walk must be either populated or not populated");
-        if(prev_drive[i].size() != 0 && prev_drive[i].size() != n) throw std::runtime_error("Graph prev_drive must be either populated or not populated");
-    }
 
-    Graph* g = new Graph();
     g->nodes = nodes;
     g->adj = adj;
-    g->dist_walk = dist_walk;
-    g->dist_drive = dist_drive;
-    g->prev_walk = prev_walk;
-    g->prev_drive = prev_drive;
+    g->build_csr();
+    g->build_spatial_index();
+
+    //precomputed sssp rows are optional, they just warm up the cache
+    for(bool walkable : {true, false}) {
+        std::string dkey = walkable ? "dist_walk" : "dist_drive";
+        std::string pkey = walkable ? "prev_walk" : "prev_drive";
+        if(!j.contains(dkey) || !j.contains(pkey)) continue;
+        std::vector<std::vector<ld>> dist = j[dkey];
+        std::vector<std::vector<int>> prev = j[pkey];
+        if(dist.size() != n) throw std::runtime_error("Graph " + dkey + " must be of size n");
+        if(prev.size() != n) throw std::runtime_error("Graph " + pkey + " must be of size n");
+        for(int i = 0; i < n; i++) {
+            if(dist[i].size() != 0 && dist[i].size() != n) throw std::runtime_error("Graph " + dkey + " must be either populated or not populated");
+            if(prev[i].size() != dist[i].size()) throw std::runtime_error("Graph " + pkey + " must match " + dkey);
+            if(dist[i].size() == 0) continue;
+            g->cache.insert(i, walkable, std::move(dist[i]), std::move(prev[i]));
+        }
+    }
 
     return g;
 }
@@ -359,6 +534,16 @@ json Graph::to_json() {
         }
     }
 
+    //only the rows currently in the cache are written out
+    std::vector<std::vector<ld>> dist_walk(n), dist_drive(n);
+    std::vector<std::vector<int>> prev_walk(n), prev_drive(n);
+    for(const PathCache::RowPtr& row : cache.rows()) {
+        int source = row->key >> 1;
+        bool walkable = row->key & 1;
+        (walkable ? dist_walk : dist_drive)[source] = row->dist;
+        (walkable ? prev_walk : prev_drive)[source] = row->prev;
+    }
+
     json ret;
     ret["nodes"] = nodes_json;
     ret["adj"] = adj_json;
@@ -370,34 +555,162 @@ json Graph::to_json() {
     return ret;
 }
 
+Graph::~Graph() {
+    delete drive_ch.load();
+    delete walk_alt.load();
+    delete drive_alt.load();
+}
+
 Graph* Graph::make_copy() {
+    Graph *g = new Graph();
     int n = this->nodes.size();
     std::vector<Node*> _nodes(n);
     for(int i = 0; i < n; i++) {
-        _nodes[i] = this->nodes[i]->make_copy();
+        _nodes[i] = this->nodes[i]->make_copy(g->arena);
     }
     std::vector<std::vector<Edge*>> _adj(n);
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < this->adj[i].size(); j++) {
-            _adj[i].push_back(this->adj[i][j]->make_copy());
+            _adj[i].push_back(this->adj[i][j]->make_copy(g->arena));
         }
     }
     
-    Graph *g = new Graph();
     g->nodes = _nodes;
     g->adj = _adj;
-    g->dist_walk = dist_walk;
-    g->dist_drive = dist_drive;
-    g->prev_walk = prev_walk;
-    g->prev_drive = prev_drive;
+    g->min_lat = min_lat, g->min_lon = min_lon, g->max_lat = max_lat, g->max_lon = max_lon;
+    g->cache = cache;
+    g->node_pos = node_pos;
+    g->walk_csr = walk_csr;
+    g->drive_csr = drive_csr;
+    g->walk_rcsr = walk_rcsr;
+    g->drive_rcsr = drive_rcsr;
+    g->walk_scc = walk_scc;
+    g->drive_scc = drive_scc;
+    g->walk_index = walk_index;
+    g->drive_index = drive_index;
+    g->node_index = node_index;
+    if(drive_ch != nullptr) g->drive_ch = new ContractionHierarchy(*drive_ch.load());
+    if(walk_alt != nullptr) g->walk_alt = new Landmarks(*walk_alt.load());
+    if(drive_alt != nullptr) g->drive_alt = new Landmarks(*drive_alt.load());
     
     return g;
 }   
 
+//tarjan's algorithm with an explicit stack, road graphs are deep enough to overflow the call stack
+Components::Components(const CSR& g) {
+    int n = g.size(), timer = 0, nr = 0;
+    comp.assign(n, -1);
+    std::vector<int> ord(n, -1), low(n), next_edge(n), path, call;
+    for(int s = 0; s < n; s++) {
+        if(ord[s] != -1) continue;
+        ord[s] = low[s] = timer ++;
+        next_edge[s] = g.offset[s];
+        path.push_back(s);
+        call.push_back(s);
+        while(call.size()) {
+            int u = call.back();
+            if(next_edge[u] < g.offset[u + 1]) {
+                int v = g.target[next_edge[u] ++];
+                if(ord[v] == -1) {
+                    ord[v] = low[v] = timer ++;
+                    next_edge[v] = g.offset[v];
+                    path.push_back(v);
+                    call.push_back(v);
+                }
+                else if(comp[v] == -1) low[u] = std::min(low[u], ord[v]);
+                continue;
+            }
+            call.pop_back();
+            if(call.size()) low[call.back()] = std::min(low[call.back()], low[u]);
+            if(low[u] != ord[u]) continue;
+
+            //u is the root of a component, which is everything above it on path
+            while(true) {
+                int x = path.back();
+                path.pop_back();
+                comp[x] = nr;
+                if(x == u) break;
+            }
+            nr ++;
+        }
+    }
+
+    std::vector<int> sz(nr, 0);
+    for(int x : comp) sz[x] ++;
+    for(int c = 0; c < nr; c++) {
+        if(main == -1 || sz[c] > sz[main]) main = c;
+    }
+}
+
+NodePositions::NodePositions(const std::vector<Node*>& nodes) {
+    int n = nodes.size();
+    lat.resize(n), lon.resize(n), x.resize(n), y.resize(n);
+    if(n == 0) return;
+    ld min_lat = nodes[0]->coord->lat, max_lat = min_lat;
+    ld min_lon = nodes[0]->coord->lon, max_lon = min_lon;
+    for(int i = 0; i < n; i++) {
+        lat[i] = nodes[i]->coord->lat;
+        lon[i] = nodes[i]->coord->lon;
+        min_lat = std::min(min_lat, lat[i]), max_lat = std::max(max_lat, lat[i]);
+        min_lon = std::min(min_lon, lon[i]), max_lon = std::max(max_lon, lon[i]);
+    }
+
+    //shrunk slightly so that rounding, and great circles bowing away from the equator between 
+    //the ends of an edge, can't push the planar distance over the haversine
+    ld shrink = 1 - std::max<ld>(1e-6, 64 * std::numeric_limits<ld>::epsilon());
+    ld ky = deg_to_rad(1) * (1000 * EARTH_RADIUS_KM) * shrink;
+    ld kx = ky * cos(deg_to_rad(std::max(std::abs(min_lat), std::abs(max_lat))));
+    ld lat0 = (min_lat + max_lat) / 2, lon0 = (min_lon + max_lon) / 2;
+    for(int i = 0; i < n; i++) {
+        x[i] = (lon[i] - lon0) * kx;
+        y[i] = (lat[i] - lat0) * ky;
+    }
+}
+
+void Graph::build_csr() {
+    node_pos = NodePositions(nodes);
+    walk_csr = CSR(adj, true);
+    drive_csr = CSR(adj, false);
+    walk_rcsr = walk_csr.transpose();
+    drive_rcsr = drive_csr.transpose();
+    walk_scc = Components(walk_csr);
+    drive_scc = Components(drive_csr);
+    cache.resize(nodes.size());
+}
+
+void Graph::build_spatial_index() {
+    std::vector<Coordinate*> walk_coords, drive_coords, coords;
+    std::vector<int> walk_ids, drive_ids, ids;
+    for(int i = 0; i < nodes.size(); i++) {
+        if(nodes[i]->is_walkable && walk_scc.in_main(i)) {
+            walk_coords.push_back(nodes[i]->coord);
+            walk_ids.push_back(i);
+        }
+        if(nodes[i]->is_driveable && drive_scc.in_main(i)) {
+            drive_coords.push_back(nodes[i]->coord);
+            drive_ids.push_back(i);
+        }
+        coords.push_back(nodes[i]->coord);
+        ids.push_back(i);
+    }
+    walk_index = SpatialIndex(walk_coords, walk_ids);
+    drive_index = SpatialIndex(drive_coords, drive_ids);
+    node_index = SpatialIndex(coords, ids);
+}
+
+//full dijkstra from start over g, shared by sssp and sssp_batch
+static void dijkstra(const CSR& g, int start, std::vector<ld>& d, std::vector<int>& p) {
+    int n = g.size();
+    p = std::vector<int>(n, -1);
+    d = std::vector<ld>(n, DIST_INF);
+    thread_local std::vector<int> touched;
+    touched.clear();
+    dijkstra(g, start, DIST_INF, d, touched, &p, [](int, ld) { return false; });
+}
+
 //single source shortest path
 //TODO 
 // - factor in speed limit
-// - use A* instead of dijkstra
 void Graph::sssp(int start, bool walkable, std::vector<ld>& d, std::vector<int>& p) {
     std::cout << "RUN SSSP : " << start << std::endl;
     int n = nodes.size();
@@ -405,34 +718,162 @@ void Graph::sssp(int start, bool walkable, std::vector<ld>& d, std::vector<int>&
     //start must refer to a valid node
     assert(0 <= start && start < n);
     
-    //run dijkstra
-    p = std::vector<int>(n, -1);
-    d = std::vector<ld>(n, 1e18);
+    dijkstra(get_csr(walkable), start, d, p);
+}
+
+void Graph::sssp_batch(const std::vector<int>& sources, bool walkable, std::vector<std::vector<ld>>& out_dist, std::vector<std::vector<int>>& out_prev) {
+    ThreadPool& pool = ThreadPool::shared();
+    std::cout << "RUN SSSP BATCH : " << sources.size() << " sources on " << pool.size() << " threads" << std::endl;
+    int n = nodes.size();
+    for(int x : sources) assert(0 <= x && x < n);
+
+    out_dist.assign(sources.size(), {});
+    out_prev.assign(sources.size(), {});
+    const CSR& g = get_csr(walkable);
+    pool.parallel_for(sources.size(), [&](int i, int thread) {
+        dijkstra(g, sources[i], out_dist[i], out_prev[i]);
+    });
+}
+
+namespace {
+
+//per thread working arrays for the point to point searches, both directions and their search 
+//trees, reset through touched the same way as SearchScratch
+struct P2PScratch {
+    std::vector<ld> dist_f, dist_b;
+    std::vector<int> par_f, par_b;
+    std::vector<int> touched;
+
+    void ensure(int n) {
+        if((int) dist_f.size() >= n) return;
+        dist_f.assign(n, DIST_INF);
+        dist_b.assign(n, DIST_INF);
+        par_f.assign(n, -1);
+        par_b.assign(n, -1);
+    }
+
+    void reset() {
+        for(int x : touched) {
+            dist_f[x] = dist_b[x] = DIST_INF;
+            par_f[x] = par_b[x] = -1;
+        }
+        touched.clear();
+    }
+};
+
+thread_local P2PScratch p2p;
+
+}
+
+ld Graph::astar(int start, int end, bool walkable, std::vector<int>* out_path) {
+    int n = nodes.size();
+    assert(0 <= start && start < n);
+    assert(0 <= end && end < n);
+    p2p.ensure(n);
+    p2p.reset();
+
+    Landmarks* alt = get_landmarks(walkable);
+    auto h = [&](int u) -> ld {
+        ld ret = node_pos.planar_dist(u, end);
+        if(alt != nullptr) ret = std::max(ret, alt->lower_bound(u, end));
+        return ret;
+    };
+
+    std::vector<ld>& d = p2p.dist_f;
+    std::vector<int>& p = p2p.par_f;
+    std::priority_queue<std::pair<ld, int>> q;    //{-(dist + h), ind}
     d[start] = 0;
-    std::priority_queue<std::pair<ld, int>> q;    //{-dist, ind}
-    q.push({0, start});
+    p2p.touched.push_back(start);
+    q.push({-h(start), start});
+    const CSR& g = get_csr(walkable);
     while(q.size()) {
-        ld cdist = -q.top().first;
+        ld key = -q.top().first;
         int cur = q.top().second;
         q.pop();
-        if(d[cur] != cdist) {
-            continue;
+        if(d[cur] + h(cur) != key) continue;
+        if(cur == end) break;
+        for(int k = g.offset[cur]; k < g.offset[cur + 1]; k++) {
+            ld ndist = d[cur] + g.weight[k];
+            int next = g.target[k];
+            if(ndist < d[next]) {
+                if(d[next] == DIST_INF) p2p.touched.push_back(next);
+                d[next] = ndist;
+                p[next] = cur;
+                q.push({-(ndist + h(next)), next});
+            }
+        }
+    }
+
+    if(out_path != nullptr) {
+        out_path->clear();
+        if(d[end] != DIST_INF) {
+            for(int ptr = end; ptr != -1; ptr = p[ptr]) out_path->push_back(ptr);
+            std::reverse(out_path->begin(), out_path->end());
         }
-        for(Edge* x : adj[cur]) {
-            //make sure we can traverse this edge
-            if(!walkable && !x->is_driveable) continue;
-            if(walkable && !x->is_walkable) continue;
-
-            //traverse the edge
-            ld ndist = cdist + x->dist; 
-            int next = x->v;
+    }
+    return d[end];
+}
+
+ld Graph::bidijkstra(int start, int end, bool walkable, std::vector<int>* out_path) {
+    int n = nodes.size();
+    assert(0 <= start && start < n);
+    assert(0 <= end && end < n);
+    p2p.ensure(n);
+    p2p.reset();
+
+    const CSR& gf = get_csr(walkable);
+    const CSR& gb = get_rcsr(walkable);
+    std::priority_queue<std::pair<ld, int>> qf, qb;   //{-dist, ind}
+    p2p.dist_f[start] = 0;
+    p2p.dist_b[end] = 0;
+    p2p.touched.push_back(start);
+    p2p.touched.push_back(end);
+    qf.push({0, start});
+    qb.push({0, end});
+
+    ld best = start == end ? 0 : DIST_INF;
+    int meet = start == end ? start : -1;
+    while(qf.size() && qb.size()) {
+        //no path through an unsettled node can beat best once the frontiers sum past it
+        ld top_f = -qf.top().first, top_b = -qb.top().first;
+        if(top_f + top_b >= best) break;
+
+        bool forward = top_f <= top_b;
+        auto& q = forward ? qf : qb;
+        const CSR& g = forward ? gf : gb;
+        std::vector<ld>& d = forward ? p2p.dist_f : p2p.dist_b;
+        std::vector<ld>& other = forward ? p2p.dist_b : p2p.dist_f;
+        std::vector<int>& p = forward ? p2p.par_f : p2p.par_b;
+
+        ld cdist = -q.top().first;
+        int cur = q.top().second;
+        q.pop();
+        if(d[cur] != cdist) continue;
+        for(int k = g.offset[cur]; k < g.offset[cur + 1]; k++) {
+            ld ndist = cdist + g.weight[k];
+            int next = g.target[k];
             if(ndist < d[next]) {
+                if(p2p.dist_f[next] == DIST_INF && p2p.dist_b[next] == DIST_INF) p2p.touched.push_back(next);
                 d[next] = ndist;
                 p[next] = cur;
                 q.push({-ndist, next});
+                if(other[next] != DIST_INF && ndist + other[next] < best) {
+                    best = ndist + other[next];
+                    meet = next;
+                }
             }
         }
     }
+
+    if(out_path != nullptr) {
+        out_path->clear();
+        if(meet != -1) {
+            for(int ptr = meet; ptr != -1; ptr = p2p.par_f[ptr]) out_path->push_back(ptr);
+            std::reverse(out_path->begin(), out_path->end());
+            for(int ptr = p2p.par_b[meet]; ptr != -1; ptr = p2p.par_b[ptr]) out_path->push_back(ptr);
+        }
+    }
+    return best;
 }
 
 ld Graph::get_dist(int start, int end, bool walkable) {
@@ -442,20 +883,134 @@ ld Graph::get_dist(int start, int end, bool walkable) {
     assert(0 <= start && start < n);
     assert(0 <= end && end < n);
 
-    if(walkable) {
-        //check if we need to run sssp on start 
-        if(this->dist_walk[start].size() == 0) {
-            this->sssp(start, walkable, this->dist_walk[start], this->prev_walk[start]);
-        }
-        return this->dist_walk[start][end];
+    if(!walkable && use_ch) {
+        return get_drive_ch()->query(start, end);
     }
-    else {
-        //check if we need to run sssp on start 
-        if(this->dist_drive[start].size() == 0) {
-            this->sssp(start, walkable, this->dist_drive[start], this->prev_drive[start]);
+
+    //a cached row already has the answer, otherwise search towards end only
+    PathCache::RowPtr row = cache_rows ? get_row(start, walkable) : cache.peek(start, walkable);
+    if(row != nullptr) return row->dist[end];
+    return point_to_point(start, end, walkable);
+}
+
+ld Graph::point_to_point(int start, int end, bool walkable, std::vector<int>* out_path) {
+    if(!walkable && get_landmarks(walkable) == nullptr) return bidijkstra(start, end, walkable, out_path);
+    return astar(start, end, walkable, out_path);
+}
+
+PathCache::RowPtr Graph::get_row(int start, bool walkable) {
+    return cache.get_or_compute(start, walkable, [&](std::vector<ld>& dist, std::vector<int>& prev) {
+        sssp(start, walkable, dist, prev);
+    });
+}
+
+ContractionHierarchy* Graph::get_drive_ch() {
+    ContractionHierarchy* ch = drive_ch.load();
+    if(ch != nullptr) return ch;
+
+    std::lock_guard<std::mutex> lock(drive_ch_mtx);
+    ch = drive_ch.load();
+    if(ch == nullptr) {
+        std::cout << "BUILDING CH : " << nodes.size() << " nodes" << std::endl;
+        ch = ContractionHierarchy::build(drive_csr);
+        std::cout << "DONE BUILDING CH : " << ch->nr_shortcuts() << " shortcuts" << std::endl;
+        drive_ch = ch;
+    }
+    return ch;
+}
+
+Landmarks* Graph::get_landmarks(bool walkable) {
+    if(nr_landmarks <= 0) return nullptr;
+    std::atomic<Landmarks*>& slot = walkable ? walk_alt : drive_alt;
+    Landmarks* alt = slot.load();
+    if(alt != nullptr) return alt;
+
+    std::lock_guard<std::mutex> lock(alt_mtx);
+    alt = slot.load();
+    if(alt == nullptr) {
+        const Components& scc = get_scc(walkable);
+        std::vector<int> candidates;
+        for(int u = 0; u < nodes.size(); u++) {
+            if(scc.in_main(u)) candidates.push_back(u);
         }
-        return this->dist_drive[start][end];
+        std::cout << "BUILDING LANDMARKS : " << nr_landmarks << " over " << candidates.size() << " nodes" << std::endl;
+        alt = Landmarks::build(get_csr(walkable), get_rcsr(walkable), node_pos, candidates, nr_landmarks);
+        slot = alt;
     }
+    return alt;
+}
+
+ld Graph::lower_bound(int u, int v, bool walkable) {
+    ld ret = node_pos.planar_dist(u, v);
+    Landmarks* alt = get_landmarks(walkable);
+    if(alt != nullptr) ret = std::max(ret, alt->lower_bound(u, v));
+    return ret;
+}
+
+void Graph::set_cache_budget(size_t bytes) {
+    cache.set_budget(bytes);
+}
+
+std::vector<ld> Graph::distance_table(const std::vector<int>& sources, const std::vector<int>& targets, bool walkable) {
+    int n = nodes.size();
+    for(int x : sources) assert(0 <= x && x < n);
+    for(int x : targets) assert(0 <= x && x < n);
+
+    if(!walkable && use_ch) {
+        return get_drive_ch()->many_to_many(sources, targets);
+    }
+
+    //otherwise run dijkstra from each root on the smaller side, stopping once the other side is settled. 
+    //backwards from the targets when there are fewer of them
+    int S = sources.size(), T = targets.size();
+    std::vector<ld> table((size_t) S * T, DIST_INF);
+    bool backward = T < S;
+    const std::vector<int>& roots = backward ? targets : sources;
+    const std::vector<int>& goals = backward ? sources : targets;
+    std::vector<std::vector<int>> goal_ids(n);
+    for(int j = 0; j < goals.size(); j++) goal_ids[goals[j]].push_back(j);
+    int distinct = 0;
+    for(int j = 0; j < goals.size(); j++) distinct += goal_ids[goals[j]][0] == j;
+    auto cell = [&](int root, int goal) -> ld& {
+        return backward ? table[(size_t) goal * T + root] : table[(size_t) root * T + goal];
+    };
+
+    //each root writes its own row (or column) of the table, so the searches run in parallel
+    const CSR& g = backward ? get_rcsr(walkable) : get_csr(walkable);
+    ThreadPool& pool = ThreadPool::shared();
+    //seen marks goals already counted, it is cleared through touched before the search is reset
+    struct Scratch {
+        SearchScratch search;
+        std::vector<char> seen;
+    };
+    std::vector<Scratch> scratch(pool.size());
+    pool.parallel_for(roots.size(), [&](int i, int thread) {
+        //a cached row already has the answers. with cache_rows a missing row is computed and kept 
+        //rather than searched only as far as the targets
+        PathCache::RowPtr row = nullptr;
+        if(!backward) row = cache_rows ? get_row(roots[i], walkable) : cache.peek(roots[i], walkable);
+        if(row != nullptr) {
+            for(int j = 0; j < T; j++) cell(i, j) = row->dist[targets[j]];
+            return;
+        }
+
+        Scratch& sc = scratch[thread];
+        if(sc.seen.size() == 0) sc.seen.assign(n, false);
+        for(int x : sc.search.touched) sc.seen[x] = false;
+        sc.search.reset(n);
+
+        //stops once every distinct goal has been settled
+        int left = distinct;
+        dijkstra(g, roots[i], DIST_INF, sc.search.d, sc.search.touched, nullptr, [&](int u, ld dist) {
+            for(int j : goal_ids[u]) cell(i, j) = dist;
+            if(goal_ids[u].size() != 0 && !sc.seen[u]) {
+                sc.seen[u] = true;
+                left --;
+            }
+            return left == 0;
+        });
+    });
+    return table;
 }
 
 //takes in start and ending node, returns a vector of path indices. 
@@ -466,47 +1021,39 @@ std::vector<int> Graph::get_path(int start, int end, bool walkable) {
     assert(0 <= start && start < n);
     assert(0 <= end && end < n);
 
-    std::vector<int> path;
-    if(walkable) {
-        //check if we need to run sssp on start 
-        if(this->dist_walk[start].size() == 0) {
-            this->sssp(start, walkable, this->dist_walk[start], this->prev_walk[start]);
-        }
-
-        //check if a path exists
-        if(this->prev_walk[start][end] == -1) {
+    if(!walkable && use_ch) {
+        std::vector<int> path = get_drive_ch()->path(start, end);
+        if(path.size() == 0) {
             throw std::runtime_error("Graph::get_path() : path does not exist");
         }
-        assert(this->dist_walk[start][end] != 1e18);
-
-        //generate path
-        int ptr = end;
-        while(ptr != -1) {
-            path.push_back(ptr);
-            ptr = this->prev_walk[start][ptr];
-        }
-        std::reverse(path.begin(), path.end());
+        return path;
     }
-    else {
-        //check if we need to run sssp on start 
-        if(this->dist_drive[start].size() == 0) {
-            this->sssp(start, walkable, this->dist_drive[start], this->prev_drive[start]);
-        }
 
-        //check if a path exists
-        if(this->prev_drive[start][end] == -1) {
+    PathCache::RowPtr cached = cache_rows ? get_row(start, walkable) : cache.peek(start, walkable);
+    if(cached == nullptr) {
+        std::vector<int> path;
+        point_to_point(start, end, walkable, &path);
+        if(path.size() == 0) {
             throw std::runtime_error("Graph::get_path() : path does not exist");
         }
-        assert(this->dist_drive[start][end] != 1e18);
+        return path;
+    }
+    const PathCache::Row& row = *cached;
 
-        //generate path
-        int ptr = end;
-        while(ptr != -1) {
-            path.push_back(ptr);
-            ptr = this->prev_drive[start][ptr];
-        }
-        std::reverse(path.begin(), path.end());
+    //check if a path exists
+    if(start != end && row.prev[end] == -1) {
+        throw std::runtime_error("Graph::get_path() : path does not exist");
     }
+    assert(row.dist[end] != DIST_INF);
+
+    //generate path
+    std::vector<int> path;
+    int ptr = end;
+    while(ptr != -1) {
+        path.push_back(ptr);
+        ptr = row.prev[ptr];
+    }
+    std::reverse(path.begin(), path.end());
 
     assert(path.size() >= 1);
     assert(path[0] == start && path[path.size() - 1] == end);
@@ -514,29 +1061,40 @@ std::vector<int> Graph::get_path(int start, int end, bool walkable) {
 }
 
 
-int Graph::get_node(Coordinate* coord, bool walkable) {
-    ld mn = 1e18;
-    int ans = -1;
-    for(int i = 0; i < nodes.size(); i++) {
-        if(walkable && !nodes[i]->is_walkable) continue;
-        if(!walkable && !nodes[i]->is_driveable) continue;
-
-        ld dist = calc_dist(coord, nodes[i]->coord);
-        if(dist < mn) {
-            mn = dist;
-            ans = i;
+std::vector<Coordinate> Graph::get_path_coords(const std::vector<int>& path, bool walkable) {
+    std::vector<Coordinate> ret;
+    for(int i = 0; i < path.size(); i++) {
+        assert(0 <= path[i] && path[i] < nodes.size());
+        if(i != 0) {
+            //the search took the shortest edge between consecutive nodes
+            Edge* best = nullptr;
+            for(Edge* e : adj[path[i - 1]]) {
+                if(e->v != path[i] || !(walkable ? e->is_walkable : e->is_driveable)) continue;
+                if(best == nullptr || e->dist < best->dist) best = e;
+            }
+            if(best == nullptr) {
+                throw std::runtime_error("Graph::get_path_coords() : no edge between consecutive path nodes");
+            }
+            for(Coordinate* c : best->geometry) ret.push_back(*c);
         }
+        ret.push_back(*nodes[path[i]]->coord);
     }
+    return ret;
+}
+
+int Graph::get_node(const Coordinate& coord, bool walkable) {
+    int ans = (walkable ? walk_index : drive_index).nearest(coord);
     // Fallback: if no node matched the requested modality, pick any closest node
     // so callers can decide how to handle failure instead of crashing.
-    if(ans == -1) {
-        for(int i = 0; i < nodes.size(); i++) {
-            ld dist = calc_dist(coord, nodes[i]->coord);
-            if(dist < mn) {
-                mn = dist;
-                ans = i;
-            }
-        }
-    }
+    if(ans == -1) ans = node_index.nearest(coord);
     return ans;
 }
+
+std::vector<int> Graph::get_node_batch(const std::vector<Coordinate>& coords, bool walkable) {
+    const SpatialIndex& index = walkable ? walk_index : drive_index;
+    return (index.size() != 0 ? index : node_index).nearest_batch(coords);
+}
+
+std::vector<int> Graph::get_nodes(const Coordinate& coord, bool walkable, int k) {
+    return (walkable ? walk_index : drive_index).k_nearest(coord, k);
+}
@@ -3,17 +3,26 @@
 #include <map>
 #include <iostream>
 #include <queue>
+#include <atomic>
+#include <mutex>
 
 #include "../defs.h"
 #include "../routing/Coordinate.h"
+#include "PathCache.h"
+#include "ContractionHierarchy.h"
+#include "Landmarks.h"
+#include "SpatialIndex.h"
+#include "OSMTags.h"
+#include "Heap.h"
+#include "ThreadPool.h"
+#include "Arena.h"
 
 //represents some location on the surface of earth
 struct OSMNode {
     ll id;
-    Coordinate* coord;
-    OSMNode(ll _id, ld _lat, ld _lon) {
+    Coordinate coord;
+    OSMNode(ll _id, ld _lat, ld _lon) : coord(_lat, _lon) {
         id = _id;
-        coord = new Coordinate(_lat, _lon);
     }
 
     static OSMNode* parse(json& j);
@@ -24,8 +33,8 @@ struct OSMNode {
 struct OSMWay {
     ll id;
     std::vector<ll> node_ids;
-    json tags;
-    OSMWay(ll _id, std::vector<ll>& _node_ids, json& _tags) {
+    WayTags tags;
+    OSMWay(ll _id, std::vector<ll>& _node_ids, WayTags _tags) {
         id = _id;
         node_ids = _node_ids;
         tags = _tags;
@@ -62,9 +71,10 @@ struct Node {
         is_driveable = _is_driveable;
     }
 
-    static Node* parse(json& j);
+    //the node and its coordinate are allocated in arena
+    static Node* parse(json& j, Arena& arena);
     json to_json();
-    Node* make_copy();
+    Node* make_copy(Arena& arena);
 };
 
 //one way connection between two Nodes. 
@@ -72,40 +82,249 @@ struct Edge {
     ll u, v;    //directed edge from u to v
     ld dist, speed_limit;
     bool is_walkable, is_driveable;
+
+    //shape points strictly between u and v in travel order, left behind when a chain of 
+    //degree 2 nodes is contracted into this edge. empty for a straight segment
+    std::vector<Coordinate*> geometry;
+
     Edge(ll _u, ll _v, ld _dist, ld _speed_limit, bool _is_driveable, bool _is_walkable) {
         u = _u, v = _v, dist = _dist, speed_limit = _speed_limit;
         is_walkable = _is_walkable, is_driveable = _is_driveable;
     }
 
-    static Edge* parse(json& j);
+    //the edge and its geometry are allocated in arena
+    static Edge* parse(json& j, Arena& arena);
     json to_json();
-    Edge* make_copy();
+    Edge* make_copy(Arena& arena);
+};
+
+//compressed sparse row adjacency restricted to a single travel mode. 
+//the outgoing edges of node u live in [offset[u], offset[u + 1]) of target and weight. 
+struct CSR {
+    std::vector<int> offset;
+    std::vector<int> target;
+    std::vector<ld> weight;
+
+    CSR() {}
+    CSR(const std::vector<std::vector<Edge*>>& adj, bool walkable);
+
+    int size() const { return (int) offset.size() - 1; }
+    int degree(int u) const { return offset[u + 1] - offset[u]; }
+
+    //same graph with every edge reversed, edge u -> v is stored at v
+    CSR transpose() const;
+};
+
+//strongly connected components of one travel mode. comp[u] is the component of node u and main is 
+//the one with the most nodes, the road network proper. the rest are fragments such as one way 
+//dead ends, private estates and islands left at the edge of the fetched box
+struct Components {
+    std::vector<int> comp;
+    int main = -1;
+
+    Components() {}
+    Components(const CSR& g);
+
+    bool in_main(int u) const { return comp[u] == main; }
+};
+
+//node coordinates as flat arrays indexed by node, for the loops that only need positions. 
+//lat and lon copy each node's coord, x and y project it onto a plane through the centre of the 
+//graph's bounding box, in metres. the east-west scale is that of the latitude furthest from the 
+//equator, so the planar distance between two nodes never exceeds the haversine between them
+struct NodePositions {
+    std::vector<ld> lat, lon;
+    std::vector<ld> x, y;
+
+    NodePositions() {}
+    NodePositions(const std::vector<Node*>& nodes);
+
+    int size() const { return lat.size(); }
+
+    //straight line distance on the plane, a lower bound on the length of any path from u to v
+    ld planar_dist(int u, int v) const {
+        ld dx = x[u] - x[v], dy = y[u] - y[v];
+        return sqrt(dx * dx + dy * dy);
+    }
 };
 
 struct Graph {
+    //owns every Node, Edge and Coordinate below, they are freed together with the graph
+    Arena arena;
+
     std::vector<Node*> nodes;
     std::vector<std::vector<Edge*>> adj;
 
-    std::vector<std::vector<ld>> dist_walk, dist_drive;
-    std::vector<std::vector<int>> prev_walk, prev_drive;
+    //box the graph was fetched for, empty (min above max) if it wasn't fetched for one. 
+    //snapshots record it so that a reader can tell whether a snapshot covers its input
+    ld min_lat = DIST_INF, min_lon = DIST_INF, max_lat = -DIST_INF, max_lon = -DIST_INF;
+    bool covers(ld _min_lat, ld _min_lon, ld _max_lat, ld _max_lon) const {
+        return min_lat <= _min_lat && min_lon <= _min_lon && max_lat >= _max_lat && max_lon >= _max_lon;
+    }
+
+    //if set, parse_osm collapses chains of degree 2 nodes into single edges that keep the 
+    //chain's coordinates as geometry. settable from the command line
+    static bool contract_chains_on_parse;
+
+    //if set, parse_osm renumbers nodes along a hilbert curve so that nodes close on the map are 
+    //close in memory. settable from the command line
+    static bool reorder_nodes_on_parse;
+
+    //if set, the one-to-many searches (sssp, sssp_batch, distance_table and dbscan's bounded 
+    //walk searches) use a RadixHeap instead of a BinaryHeap. settable from the command line
+    static bool use_radix_heap;
+
+    //if set, parse_osm drops every edge outside the main strongly connected component of its modes, 
+    //and the nodes left without edges. settable from the command line
+    static bool prune_fragments_on_parse;
+
+    //per-mode flattened copies of adj, all shortest path code runs on these
+    CSR walk_csr, drive_csr;
+
+    //transposes of walk_csr and drive_csr, for searches that run backwards from a target
+    CSR walk_rcsr, drive_rcsr;
+
+    //strongly connected components of walk_csr and drive_csr, rebuilt together with them
+    Components walk_scc, drive_scc;
+
+    //positions of nodes, rebuilt together with the CSRs
+    NodePositions node_pos;
+
+    //sssp rows shared by get_row, get_dist, get_path and distance_table
+    PathCache cache;
+
+    //if set, get_dist and get_path compute and cache the whole row of start on a miss instead of 
+    //running a point to point search, concurrent misses on one row compute it once. pays off when the 
+    //same sources are queried for many targets, at up to PathCache's budget in memory. settable from the command line
+    static bool cache_rows;
+
+    //if use_ch is set, drive mode get_dist, get_path and distance_table are answered by a contraction 
+    //hierarchy that is built on the first such query. settable from the command line
+    static bool use_ch;
+    std::atomic<ContractionHierarchy*> drive_ch{nullptr};
+    std::mutex drive_ch_mtx;
+
+    //number of ALT landmarks per travel mode, 0 turns them off. each costs two searches to set up and 
+    //2 * sizeof(ld) bytes per node. settable from the command line
+    static int nr_landmarks;
+
+    //landmarks of each mode among the nodes of its main component, built on the first astar or 
+    //lower_bound call that needs them
+    std::atomic<Landmarks*> walk_alt{nullptr}, drive_alt{nullptr};
+    std::mutex alt_mtx;
+
+    //nearest node lookups over walkable, driveable and all nodes
+    SpatialIndex walk_index, drive_index, node_index;
 
     Graph() {}
+    ~Graph();
     static Graph* parse_osm(json& j);
 
+    //same as above, reading the overpass response from a stream without building its json
+    static Graph* parse_osm(std::istream& in, std::string* remark = nullptr);
+
     static Graph* parse(json& j);
     json to_json();
     Graph* make_copy();
 
+    //versioned binary snapshot of the bounding box, nodes, edges, per-mode CSRs, spatial indexes and, if they have been 
+    //built, the drive contraction hierarchy and the landmarks. the file is memory mapped on load and every array is 
+    //copied out in one piece and checked against the node count. a graph without a bounding box is written with 
+    //the extent of its nodes. snapshots are only readable by builds with the same ld type
+    void write_snapshot(const std::string& filepath);
+    static Graph* read_snapshot(const std::string& filepath);
+
+    //removes every node whose only connections are one edge in and one edge out along each direction 
+    //of a single road, merging the two edges into one and keeping the node as edge geometry. 
+    //also drops edges usable in neither mode and nodes left without edges. nodes are renumbered, 
+    //so this must run before anything refers to node indices
+    void contract_chains();
+
+    //takes every mode away from edges that leave or lie outside that mode's main strongly connected 
+    //component, then drops edges with no mode left and nodes with no edges left. afterwards any 
+    //walkable node can walk to any other and the same for driving. nodes are renumbered, so this 
+    //must run before anything refers to node indices
+    void prune_fragments();
+
+    //moves node u to index new_ind[u] and rewrites the edges to match. nodes with new_ind -1 are 
+    //dropped, their edges and any edge leading to them must already be gone
+    void renumber(const std::vector<int>& new_ind);
+
+    //renumbers nodes in hilbert curve order over their bounding box, so a search frontier walks 
+    //mostly contiguous memory in nodes, adj, the CSRs and every distance row. like contract_chains 
+    //this must run before anything refers to node indices. students and stops only learn their 
+    //nodes through get_node afterwards, so they never see the old numbering
+    void reorder_nodes();
+
+    //rebuilds walk_csr, drive_csr, their transposes and components from adj and node_pos from nodes, 
+    //and resizes the cache to match
+    void build_csr();
+    const CSR& get_csr(bool walkable) const { return walkable ? walk_csr : drive_csr; }
+    const CSR& get_rcsr(bool walkable) const { return walkable ? walk_rcsr : drive_rcsr; }
+    const Components& get_scc(bool walkable) const { return walkable ? walk_scc : drive_scc; }
+
+    //rebuilds walk_index, drive_index and node_index from nodes. walk_index and drive_index only hold 
+    //the main component of their mode, so get_node never snaps onto a fragment
+    void build_spatial_index();
+
     //single source shortest paths
     void sssp(int start, bool walkable, std::vector<ld>& out_dist, std::vector<int>& out_prev);
 
+    //sssp from every source, spread over the shared thread pool. out_dist[i] and out_prev[i] belong to sources[i]. 
+    //rows are not added to the cache
+    void sssp_batch(const std::vector<int>& sources, bool walkable, std::vector<std::vector<ld>>& out_dist, std::vector<std::vector<int>>& out_prev);
+
+    //point to point searches that stop once end is settled and leave the cache alone. 
+    //both return the distance (DIST_INF if end is unreachable) and, if out_path is given, 
+    //fill it with the nodes on the path including both ends (empty if unreachable). 
+    //astar is guided by lower_bound
+    ld astar(int start, int end, bool walkable, std::vector<int>* out_path = nullptr);
+    ld bidijkstra(int start, int end, bool walkable, std::vector<int>* out_path = nullptr);
+
+    //the point to point search get_dist and get_path fall back to. astar, except for driving without 
+    //landmarks, where the planar bound alone is loose enough around one ways and roads closed to 
+    //cars that bidijkstra settles fewer nodes
+    ld point_to_point(int start, int end, bool walkable, std::vector<int>* out_path = nullptr);
+
+    //the cached sssp row of start, computed on a miss. safe to call from several threads, 
+    //concurrent misses on the same row compute it once
+    PathCache::RowPtr get_row(int start, bool walkable);
+
     ld get_dist(int start, int end, bool walkable);
 
+    //builds drive_ch if it hasn't been built yet, only one thread builds it
+    ContractionHierarchy* get_drive_ch();
+
+    //the landmarks of a mode, built if they haven't been yet. nullptr if nr_landmarks is 0
+    Landmarks* get_landmarks(bool walkable);
+
+    //a distance that the shortest path from u to v is never shorter than, the better of the planar 
+    //distance and the landmark bound. cheap enough to rule out pairs before asking get_dist
+    ld lower_bound(int u, int v, bool walkable);
+
+    //shortest distances from every source to every target, row major sources.size() x targets.size(). 
+    //unreachable pairs are DIST_INF. without a hierarchy this runs one search per source or, if there are 
+    //fewer targets, one reverse search per target
+    std::vector<ld> distance_table(const std::vector<int>& sources, const std::vector<int>& targets, bool walkable);
+
+    //caps the memory used by cached sssp rows
+    void set_cache_budget(size_t bytes);
+
     //returns nodes on path from start to end node, including the start and end
     std::vector<int> get_path(int start, int end, bool walkable);
 
-    //given some information, returns the node in graph that best matches it
-    int get_node(Coordinate* coord, bool walkable);
+    //full polyline of a path returned by get_path, with the geometry of each edge filled in
+    std::vector<Coordinate> get_path_coords(const std::vector<int>& path, bool walkable);
+
+    //given some information, returns the node in graph that best matches it. the node is in the 
+    //main component of the mode, unless the mode has no nodes at all
+    int get_node(const Coordinate& coord, bool walkable);
+
+    //get_node of every coordinate in one call, spread over the shared thread pool
+    std::vector<int> get_node_batch(const std::vector<Coordinate>& coords, bool walkable);
+
+    //the k nodes of the given mode closest to coord, closest first
+    std::vector<int> get_nodes(const Coordinate& coord, bool walkable, int k);
     // TODO
     // int get_node(std::string addr);
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+#include "../defs.h"
+
+//priority queues for dijkstra. both pop entries in order of increasing distance and 
+//return the exact distance that was pushed, stale entries are left for the caller to skip. 
+
+//binary heap with lazy deletion
+struct BinaryHeap {
+    //how far out of order entries can be popped
+    static constexpr ld SLACK = 0;
+
+    std::vector<std::pair<ld, int>> q;    //{-dist, ind}, max heap
+
+    void push(ld dist, int u) {
+        q.push_back({-dist, u});
+        std::push_heap(q.begin(), q.end());
+    }
+    std::pair<ld, int> pop() {
+        std::pop_heap(q.begin(), q.end());
+        std::pair<ld, int> ret = {-q.back().first, q.back().second};
+        q.pop_back();
+        return ret;
+    }
+    bool empty() const { return q.empty(); }
+
+    //keeps the allocated storage
+    void clear() { q.clear(); }
+};
+
+//radix heap keyed on distances quantised to RESOLUTION. only valid for monotone use, 
+//every pushed distance must be at least the last popped one, which dijkstra guarantees. 
+//entries within one quantum may come out of order, dijkstra's stale check then just 
+//relaxes the node again, so distances stay exact. 
+struct RadixHeap {
+    //keys are distance / RESOLUTION, i.e. millimetres for distances in metres
+    static constexpr ld RESOLUTION = 1e-3;
+    static constexpr ld SLACK = RESOLUTION;
+
+    struct Entry {
+        uint64_t key;
+        ld dist;
+        int u;
+    };
+
+    //bucket i holds keys whose highest bit differing from last is bit i - 1, bucket 0 holds key == last
+    std::vector<Entry> buckets[65];
+    uint64_t last = 0;
+    size_t cnt = 0;
+
+    static int bucket_of(uint64_t key, uint64_t last) {
+        return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+    }
+
+    void push(ld dist, int u) {
+        uint64_t key = (uint64_t) (dist / RESOLUTION);
+        if(key < last) key = last;      //rounding on an edge shorter than a quantum
+        buckets[bucket_of(key, last)].push_back({key, dist, u});
+        cnt ++;
+    }
+
+    std::pair<ld, int> pop() {
+        assert(cnt > 0);
+        if(buckets[0].empty()) {
+            //redistribute the first non empty bucket around its minimum, everything lands in lower buckets
+            int i = 1;
+            while(buckets[i].empty()) i ++;
+            uint64_t mn = buckets[i][0].key;
+            for(const Entry& e : buckets[i]) mn = std::min(mn, e.key);
+            last = mn;
+            for(const Entry& e : buckets[i]) buckets[bucket_of(e.key, last)].push_back(e);
+            buckets[i].clear();
+        }
+        Entry e = buckets[0].back();
+        buckets[0].pop_back();
+        cnt --;
+        return {e.dist, e.u};
+    }
+
+    bool empty() const { return cnt == 0; }
+
+    //keeps the allocated storage
+    void clear() {
+        for(std::vector<Entry>& b : buckets) b.clear();
+        last = 0;
+        cnt = 0;
+    }
+};
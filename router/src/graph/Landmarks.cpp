@@ -0,0 +1,46 @@
+#include "Landmarks.h"
+#include "Graph.h"
+#include "Dijkstra.h"
+#include "ThreadPool.h"
+
+Landmarks* Landmarks::build(const CSR& g, const CSR& rg, const NodePositions& pos, const std::vector<int>& candidates, int k) {
+    Landmarks* ret = new Landmarks();
+    ret->n = g.size();
+    if(candidates.size() == 0) k = 0;
+
+    //farthest point selection on the plane, starting from the candidate furthest from the middle of the map.
+    //gap[j] is the distance from candidates[j] to the closest landmark picked so far
+    std::vector<ld> gap(candidates.size());
+    for(int j = 0; j < candidates.size(); j++) {
+        int u = candidates[j];
+        gap[j] = pos.x[u] * pos.x[u] + pos.y[u] * pos.y[u];
+    }
+    while(ret->nodes.size() < k) {
+        int best = std::max_element(gap.begin(), gap.end()) - gap.begin();
+        if(ret->nodes.size() != 0 && gap[best] == 0) break;
+        int l = candidates[best];
+        ret->nodes.push_back(l);
+        for(int j = 0; j < candidates.size(); j++) {
+            ld d = pos.planar_dist(candidates[j], l);
+            gap[j] = ret->nodes.size() == 1 ? d : std::min(gap[j], d);
+        }
+    }
+    k = ret->k = ret->nodes.size();
+
+    //one full search per landmark and direction, job 2i fills from and 2i + 1 fills to for landmark i.
+    //the jobs write disjoint entries of from and to
+    ret->from.assign((size_t) ret->n * k, DIST_INF);
+    ret->to.assign((size_t) ret->n * k, DIST_INF);
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<SearchScratch> scratch(pool.size());
+    pool.parallel_for(2 * k, [&](int job, int thread) {
+        int i = job / 2;
+        bool forward = job % 2 == 0;
+        SearchScratch& sc = scratch[thread];
+        sc.reset(ret->n);
+        dijkstra(forward ? g : rg, ret->nodes[i], DIST_INF, sc.d, sc.touched, nullptr, [](int, ld) { return false; });
+        std::vector<ld>& out = forward ? ret->from : ret->to;
+        for(int u : sc.touched) out[(size_t) u * k + i] = sc.d[u];
+    });
+    return ret;
+}
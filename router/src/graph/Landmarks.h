@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+
+#include "../defs.h"
+
+struct CSR;
+struct NodePositions;
+
+//ALT (A*, landmarks, triangle inequality) lower bounds over a single travel mode.
+//for a landmark L the triangle inequality gives d(u, v) >= d(L, v) - d(L, u) and d(u, v) >= d(u, L) - d(v, L).
+//with a handful of landmarks spread around the edge of the map the best of these is usually far
+//tighter than the straight line distance, which knows nothing about rivers or highways in the way.
+struct Landmarks {
+    int n, k;
+
+    //the landmark nodes
+    std::vector<int> nodes;
+
+    //from[u * k + i] is the distance from landmark i to u and to[u * k + i] the distance from u to
+    //landmark i, DIST_INF if there is no path. node major, so a bound reads two short runs
+    std::vector<ld> from, to;
+
+    Landmarks() { n = k = 0; }
+
+    //picks k landmarks among candidates, each as far on the map as possible from the ones picked before,
+    //and runs a search from and to each of them over g and its transpose rg
+    static Landmarks* build(const CSR& g, const CSR& rg, const NodePositions& pos, const std::vector<int>& candidates, int k);
+
+    //lower bound on the distance from u to v, 0 if no landmark says anything
+    ld lower_bound(int u, int v) const {
+        const ld *fu = &from[(size_t) u * k], *fv = &from[(size_t) v * k];
+        const ld *tu = &to[(size_t) u * k], *tv = &to[(size_t) v * k];
+        ld ret = 0;
+        for(int i = 0; i < k; i++) {
+            if(fu[i] != DIST_INF && fv[i] != DIST_INF && fv[i] - fu[i] > ret) ret = fv[i] - fu[i];
+            if(tu[i] != DIST_INF && tv[i] != DIST_INF && tu[i] - tv[i] > ret) ret = tu[i] - tv[i];
+        }
+        return ret;
+    }
+};
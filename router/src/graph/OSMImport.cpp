@@ -0,0 +1,447 @@
+#include "OSMImport.h"
+#include "OSMParser.h"
+#include "../config.h"
+
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+#include <unordered_set>
+
+#if !_ISWASM
+    #include <zlib.h>
+#endif
+
+std::string OSMImporter::extract_path = "";
+
+Graph* OSMImporter::import(const std::string& filepath, ld min_lat, ld min_lon, ld max_lat, ld max_lon) {
+    bool is_pbf = filepath.size() >= 4 && filepath.compare(filepath.size() - 4, 4, ".pbf") == 0;
+    auto read = [&](const NodeFn& node_fn, const WayFn& way_fn) {
+        if(is_pbf) read_pbf(filepath, node_fn, way_fn);
+        else read_xml(filepath, node_fn, way_fn);
+    };
+
+    //first pass : nodes inside the box, then the highway ways touching them
+    std::unordered_set<ll> inside, needed;
+    std::vector<OSMWay*> ways;
+    read(
+        [&](ll id, ld lat, ld lon) {
+            if(lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon) inside.insert(id);
+        },
+        [&](ll id, std::vector<ll>& refs, Tags& tags) {
+            WayTags way_tags;
+            for(auto& [k, v] : tags) way_tags.set(k, v);
+
+            //same filter as the overpass query
+            if(way_tags.highway == WayTags::HW_NONE || way_tags.area) return;
+            if(way_tags.highway == WayTags::HW_CONSTRUCTION || way_tags.highway == WayTags::HW_PROPOSED) return;
+            if(std::none_of(refs.begin(), refs.end(), [&](ll r) { return inside.count(r) != 0; })) return;
+
+            ways.push_back(new OSMWay(id, refs, way_tags));
+            needed.insert(refs.begin(), refs.end());
+        }
+    );
+    inside.clear();
+
+    //second pass : coordinates of every node the kept ways use
+    OSMGraphBuilder builder;
+    read(
+        [&](ll id, ld lat, ld lon) {
+            if(needed.count(id)) builder.add_node(id, lat, lon);
+        },
+        nullptr
+    );
+
+    //ways running off the edge of the extract reference nodes it doesn't have
+    int nr_cut = 0;
+    for(OSMWay* way : ways) {
+        bool complete = true;
+        for(ll r : way->node_ids) complete &= builder.node_inds.count(r) != 0;
+        if(complete) builder.add_way(way);
+        else {
+            nr_cut ++;
+            delete way;
+        }
+    }
+    std::cout << "IMPORTED EXTRACT : " << builder.nodes.size() << " nodes, " << ways.size() - nr_cut << " ways";
+    if(nr_cut) std::cout << ", skipped " << nr_cut << " ways leaving the extract";
+    std::cout << std::endl;
+    return builder.build();
+}
+
+#if _ISWASM
+
+void OSMImporter::read_pbf(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn) {
+    throw std::runtime_error("OSMImporter::read_pbf() : not available in the browser");
+}
+
+void OSMImporter::read_xml(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn) {
+    throw std::runtime_error("OSMImporter::read_xml() : not available in the browser");
+}
+
+#else
+
+namespace {
+
+//reader over a protobuf message, just the wire format the osm pbf schema needs
+struct Protobuf {
+    const uint8_t* p;
+    const uint8_t* end;
+    int field = 0, wire = 0;
+
+    Protobuf(const uint8_t* _p, const uint8_t* _end) : p(_p), end(_end) {}
+    Protobuf(std::string_view s) : p((const uint8_t*) s.data()), end((const uint8_t*) s.data() + s.size()) {}
+
+    bool next() {
+        if(p >= end) return false;
+        uint64_t key = varint();
+        field = key >> 3;
+        wire = key & 7;
+        return true;
+    }
+
+    uint64_t varint() {
+        uint64_t x = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            if(p >= end) break;
+            uint8_t b = *p++;
+            x |= (uint64_t) (b & 0x7f) << shift;
+            if(!(b & 0x80)) return x;
+        }
+        throw std::runtime_error("OSMImporter::read_pbf() : malformed varint");
+    }
+
+    int64_t svarint() {
+        uint64_t x = varint();
+        return (int64_t) (x >> 1) ^ -(int64_t) (x & 1);
+    }
+
+    std::string_view bytes() {
+        uint64_t len = varint();
+        if(len > (uint64_t) (end - p)) throw std::runtime_error("OSMImporter::read_pbf() : field runs past its message");
+        std::string_view ret((const char*) p, len);
+        p += len;
+        return ret;
+    }
+
+    void skip() {
+        size_t len = 0;
+        if(wire == 0) varint();
+        else if(wire == 2) bytes();
+        else if(wire == 1) len = 8;
+        else if(wire == 5) len = 4;
+        else throw std::runtime_error("OSMImporter::read_pbf() : unknown wire type " + std::to_string(wire));
+        if(len > (size_t) (end - p)) throw std::runtime_error("OSMImporter::read_pbf() : field runs past its message");
+        p += len;
+    }
+
+    //repeated integer field, packed or not. read is called with the reader to take one value from
+    template<class F>
+    void repeated(F read) {
+        if(wire != 2) {
+            read(*this);
+            return;
+        }
+        Protobuf packed(bytes());
+        while(packed.p < packed.end) read(packed);
+    }
+};
+
+//reads the next blob of the file into data, returns false at the end of the file
+bool read_blob(std::ifstream& in, std::string& type, std::string& data) {
+    uint8_t len_be[4];
+    in.read((char*) len_be, 4);
+    if(in.gcount() == 0) return false;
+    if(in.gcount() != 4) throw std::runtime_error("OSMImporter::read_pbf() : truncated blob header");
+    uint32_t header_len = (uint32_t) len_be[0] << 24 | (uint32_t) len_be[1] << 16 | (uint32_t) len_be[2] << 8 | len_be[3];
+    if(header_len > (1 << 16)) throw std::runtime_error("OSMImporter::read_pbf() : blob header too large");
+
+    std::string header(header_len, 0);
+    in.read(header.data(), header_len);
+    if(in.gcount() != header_len) throw std::runtime_error("OSMImporter::read_pbf() : truncated blob header");
+    uint64_t data_size = 0;
+    type.clear();
+    for(Protobuf h(header); h.next(); ) {
+        if(h.field == 1 && h.wire == 2) type = h.bytes();
+        else if(h.field == 3 && h.wire == 0) data_size = h.varint();
+        else h.skip();
+    }
+    if(data_size > (1 << 25)) throw std::runtime_error("OSMImporter::read_pbf() : blob too large");
+
+    std::string blob(data_size, 0);
+    in.read(blob.data(), data_size);
+    if(in.gcount() != data_size) throw std::runtime_error("OSMImporter::read_pbf() : truncated blob");
+    std::string_view raw, zlib_data;
+    uint64_t raw_size = 0;
+    for(Protobuf b(blob); b.next(); ) {
+        if(b.field == 1 && b.wire == 2) raw = b.bytes();
+        else if(b.field == 2 && b.wire == 0) raw_size = b.varint();
+        else if(b.field == 3 && b.wire == 2) zlib_data = b.bytes();
+        else if(b.field >= 4 && b.field <= 7) throw std::runtime_error("OSMImporter::read_pbf() : only raw and zlib blobs are supported");
+        else b.skip();
+    }
+
+    if(zlib_data.data() == nullptr) {
+        data.assign(raw.data(), raw.size());
+        return true;
+    }
+    if(raw_size > (1 << 25)) throw std::runtime_error("OSMImporter::read_pbf() : blob too large");
+    data.resize(raw_size);
+    uLongf out_len = raw_size;
+    if(uncompress((Bytef*) data.data(), &out_len, (const Bytef*) zlib_data.data(), zlib_data.size()) != Z_OK || out_len != raw_size) {
+        throw std::runtime_error("OSMImporter::read_pbf() : corrupt zlib blob");
+    }
+    return true;
+}
+
+}
+
+void OSMImporter::read_pbf(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn) {
+    std::ifstream in(filepath, std::ios::binary);
+    if(!in) throw std::runtime_error("OSMImporter::read_pbf() : cannot open " + filepath);
+
+    std::string type, data;
+    std::vector<std::string_view> strings;
+    std::vector<std::string_view> groups;
+    std::vector<ll> ids, refs;
+    std::vector<int64_t> lats, lons;
+    std::vector<uint32_t> keys, vals;
+    Tags tags;
+    while(read_blob(in, type, data)) {
+        if(type != "OSMData") continue;
+
+        //stringtable, granularity and offsets may come after the groups
+        strings.clear();
+        groups.clear();
+        int64_t granularity = 100, lat_offset = 0, lon_offset = 0;
+        for(Protobuf block(data); block.next(); ) {
+            if(block.field == 1 && block.wire == 2) {
+                for(Protobuf table(block.bytes()); table.next(); ) {
+                    if(table.field == 1 && table.wire == 2) strings.push_back(table.bytes());
+                    else table.skip();
+                }
+            }
+            else if(block.field == 2 && block.wire == 2) groups.push_back(block.bytes());
+            else if(block.field == 17 && block.wire == 0) granularity = block.varint();
+            else if(block.field == 19 && block.wire == 0) lat_offset = block.varint();
+            else if(block.field == 20 && block.wire == 0) lon_offset = block.varint();
+            else block.skip();
+        }
+        //dividing the exact integer by 1e9 rounds the same way parsing overpass's decimal text does
+        auto to_deg = [&](int64_t x, int64_t offset) -> ld { return (double) (offset + granularity * x) / 1e9; };
+
+        for(std::string_view group : groups) {
+            for(Protobuf g(group); g.next(); ) {
+                if(g.field == 1 && g.wire == 2) {
+                    ll id = 0;
+                    int64_t lat = 0, lon = 0;
+                    for(Protobuf node(g.bytes()); node.next(); ) {
+                        if(node.field == 1) id = node.svarint();
+                        else if(node.field == 8) lat = node.svarint();
+                        else if(node.field == 9) lon = node.svarint();
+                        else node.skip();
+                    }
+                    node_fn(id, to_deg(lat, lat_offset), to_deg(lon, lon_offset));
+                }
+                else if(g.field == 2 && g.wire == 2) {
+                    ids.clear(), lats.clear(), lons.clear();
+                    for(Protobuf dense(g.bytes()); dense.next(); ) {
+                        if(dense.field == 1) dense.repeated([&](Protobuf& r) { ids.push_back(r.svarint()); });
+                        else if(dense.field == 8) dense.repeated([&](Protobuf& r) { lats.push_back(r.svarint()); });
+                        else if(dense.field == 9) dense.repeated([&](Protobuf& r) { lons.push_back(r.svarint()); });
+                        else dense.skip();
+                    }
+                    if(lats.size() != ids.size() || lons.size() != ids.size()) throw std::runtime_error("OSMImporter::read_pbf() : malformed dense nodes");
+                    ll id = 0;
+                    int64_t lat = 0, lon = 0;
+                    for(size_t i = 0; i < ids.size(); i++) {
+                        id += ids[i], lat += lats[i], lon += lons[i];
+                        node_fn(id, to_deg(lat, lat_offset), to_deg(lon, lon_offset));
+                    }
+                }
+                else if(g.field == 3 && g.wire == 2) {
+                    if(!way_fn) return;
+                    ll id = 0;
+                    refs.clear(), keys.clear(), vals.clear();
+                    for(Protobuf way(g.bytes()); way.next(); ) {
+                        if(way.field == 1) id = way.varint();
+                        else if(way.field == 2) way.repeated([&](Protobuf& r) { keys.push_back(r.varint()); });
+                        else if(way.field == 3) way.repeated([&](Protobuf& r) { vals.push_back(r.varint()); });
+                        else if(way.field == 8) {
+                            ll ref = 0;
+                            way.repeated([&](Protobuf& r) { ref += r.svarint(); refs.push_back(ref); });
+                        }
+                        else way.skip();
+                    }
+                    if(keys.size() != vals.size()) throw std::runtime_error("OSMImporter::read_pbf() : malformed way tags");
+                    tags.clear();
+                    for(size_t i = 0; i < keys.size(); i++) {
+                        if(keys[i] >= strings.size() || vals[i] >= strings.size()) throw std::runtime_error("OSMImporter::read_pbf() : string index out of range");
+                        tags.push_back({strings[keys[i]], strings[vals[i]]});
+                    }
+                    way_fn(id, refs, tags);
+                }
+                else g.skip();
+            }
+        }
+    }
+}
+
+namespace {
+
+//replaces the five predefined entities and character references
+std::string xml_decode(std::string_view s) {
+    std::string ret;
+    ret.reserve(s.size());
+    for(size_t i = 0; i < s.size(); i++) {
+        if(s[i] != '&') {
+            ret += s[i];
+            continue;
+        }
+        size_t semi = s.find(';', i);
+        if(semi == std::string_view::npos) {
+            ret += s[i];
+            continue;
+        }
+        std::string_view ent = s.substr(i + 1, semi - i - 1);
+        if(ent == "amp") ret += '&';
+        else if(ent == "lt") ret += '<';
+        else if(ent == "gt") ret += '>';
+        else if(ent == "quot") ret += '"';
+        else if(ent == "apos") ret += '\'';
+        else if(ent.size() > 1 && ent[0] == '#') {
+            uint32_t c = ent[1] == 'x' ? std::stoul(std::string(ent.substr(2)), nullptr, 16) : std::stoul(std::string(ent.substr(1)));
+            //utf-8 encode
+            if(c < 0x80) ret += (char) c;
+            else if(c < 0x800) ret += (char) (0xc0 | c >> 6), ret += (char) (0x80 | (c & 0x3f));
+            else if(c < 0x10000) ret += (char) (0xe0 | c >> 12), ret += (char) (0x80 | (c >> 6 & 0x3f)), ret += (char) (0x80 | (c & 0x3f));
+            else ret += (char) (0xf0 | c >> 18), ret += (char) (0x80 | (c >> 12 & 0x3f)), ret += (char) (0x80 | (c >> 6 & 0x3f)), ret += (char) (0x80 | (c & 0x3f));
+        }
+        else {
+            ret += s[i];
+            continue;
+        }
+        i = semi;
+    }
+    return ret;
+}
+
+//value of attribute name inside the text of a start tag, empty if it isn't there
+std::string_view xml_attr(std::string_view tag, std::string_view name) {
+    size_t at = 0;
+    while((at = tag.find(name, at)) != std::string_view::npos) {
+        size_t eq = at + name.size();
+        bool starts = at > 0 && (tag[at - 1] == ' ' || tag[at - 1] == '\t' || tag[at - 1] == '\n' || tag[at - 1] == '\r');
+        while(eq < tag.size() && tag[eq] == ' ') eq++;
+        if(starts && eq + 1 < tag.size() && tag[eq] == '=') {
+            size_t q = eq + 1;
+            while(q < tag.size() && tag[q] == ' ') q++;
+            if(q < tag.size() && (tag[q] == '"' || tag[q] == '\'')) {
+                size_t close = tag.find(tag[q], q + 1);
+                if(close == std::string_view::npos) break;
+                return tag.substr(q + 1, close - q - 1);
+            }
+        }
+        at += name.size();
+    }
+    return {};
+}
+
+}
+
+void OSMImporter::read_xml(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn) {
+    //gzread passes uncompressed files through as they are
+    gzFile in = gzopen(filepath.c_str(), "rb");
+    if(in == nullptr) throw std::runtime_error("OSMImporter::read_xml() : cannot open " + filepath);
+    gzbuffer(in, 1 << 18);
+
+    std::string buf;
+    size_t pos = 0;
+    bool in_way = false, done = false;
+    ll way_id = 0;
+    std::vector<ll> refs;
+    std::vector<std::pair<std::string, std::string>> tag_store;
+    Tags tags;
+
+    auto emit_way = [&]() {
+        tags.clear();
+        for(auto& [k, v] : tag_store) tags.push_back({k, v});
+        way_fn(way_id, refs, tags);
+        in_way = false;
+    };
+
+    char chunk[1 << 16];
+    while(!done) {
+        int len = gzread(in, chunk, sizeof(chunk));
+        if(len < 0) {
+            gzclose(in);
+            throw std::runtime_error("OSMImporter::read_xml() : failed reading " + filepath);
+        }
+        if(len == 0) break;
+        buf.erase(0, pos);
+        pos = 0;
+        buf.append(chunk, len);
+
+        //handle every complete tag in the buffer
+        while(!done) {
+            size_t open = buf.find('<', pos);
+            if(open == std::string::npos) {
+                pos = buf.size();
+                break;
+            }
+            size_t close = open + 1;
+            char quote = 0;
+            for(; close < buf.size(); close++) {
+                if(quote) {
+                    if(buf[close] == quote) quote = 0;
+                }
+                else if(buf[close] == '"' || buf[close] == '\'') quote = buf[close];
+                else if(buf[close] == '>') break;
+            }
+            if(close >= buf.size()) {
+                pos = open;
+                break;
+            }
+            std::string_view tag(buf.data() + open + 1, close - open - 1);
+            pos = close + 1;
+
+            if(tag.empty() || tag[0] == '?' || tag[0] == '!') continue;
+            if(tag[0] == '/') {
+                if(in_way && tag.substr(1, 3) == "way") emit_way();
+                continue;
+            }
+            size_t name_end = tag.find_first_of(" \t\r\n/");
+            std::string_view name = tag.substr(0, name_end);
+            bool self_closing = tag.back() == '/';
+
+            if(name == "node") {
+                std::string_view lat = xml_attr(tag, "lat"), lon = xml_attr(tag, "lon");
+                node_fn(
+                    std::stoll(std::string(xml_attr(tag, "id"))),
+                    std::strtod(std::string(lat).c_str(), nullptr),
+                    std::strtod(std::string(lon).c_str(), nullptr)
+                );
+            }
+            else if(name == "way") {
+                if(!way_fn) {
+                    done = true;
+                    break;
+                }
+                way_id = std::stoll(std::string(xml_attr(tag, "id")));
+                refs.clear();
+                tag_store.clear();
+                in_way = true;
+                if(self_closing) emit_way();
+            }
+            else if(name == "nd" && in_way) {
+                refs.push_back(std::stoll(std::string(xml_attr(tag, "ref"))));
+            }
+            else if(name == "tag" && in_way) {
+                tag_store.push_back({xml_decode(xml_attr(tag, "k")), xml_decode(xml_attr(tag, "v"))});
+            }
+        }
+    }
+    gzclose(in);
+}
+
+#endif
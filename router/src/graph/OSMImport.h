@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <string_view>
+#include <functional>
+
+#include "Graph.h"
+
+//builds road graphs from a local osm extract, either .osm.pbf or .osm xml (optionally gzipped), 
+//instead of querying overpass. the extract is cropped to the requested box with the same selection 
+//as utils::make_overpass_query : every highway way with a node inside the box, together with all of 
+//its nodes, classified and turned into edges by the same OSMGraphBuilder as parse_osm. 
+//
+//the file is read twice, once for the ways and the ids of the nodes inside the box and once for 
+//the coordinates of the nodes those ways use, so memory stays proportional to the box and not to 
+//the extract. extracts are expected to be sorted with nodes before ways, as osmium and geofabrik 
+//write them. 
+struct OSMImporter {
+    //extract used by utils::create_graph, overpass is queried when empty. settable from the command line
+    static std::string extract_path;
+
+    typedef std::vector<std::pair<std::string_view, std::string_view>> Tags;
+    typedef std::function<void(ll, ld, ld)> NodeFn;
+    typedef std::function<void(ll, std::vector<ll>&, Tags&)> WayFn;
+
+    static Graph* import(const std::string& filepath, ld min_lat, ld min_lon, ld max_lat, ld max_lon);
+
+    //call node_fn and way_fn for every node and way in the file. 
+    //if way_fn is empty, reading stops at the first way
+    static void read_pbf(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn);
+    static void read_xml(const std::string& filepath, const NodeFn& node_fn, const WayFn& way_fn);
+};
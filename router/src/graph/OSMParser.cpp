@@ -0,0 +1,226 @@
+#include "OSMParser.h"
+
+#include <numeric>
+#include <algorithm>
+
+ld calc_dist(Coordinate* a, Coordinate* b);
+
+//only frees anything if build() was never reached
+OSMGraphBuilder::~OSMGraphBuilder() {
+    for(OSMWay* way : pending) delete way;
+    delete g;
+}
+
+void OSMGraphBuilder::add_node(ll id, ld lat, ld lon) {
+    if(node_inds.count(id)) return;
+    node_inds.insert({id, (int) nodes.size()});
+    osm_ids.push_back(id);
+    nodes.push_back(g->arena.make<Node>(nodes.size(), g->arena.make<Coordinate>(lat, lon)));
+    adj.emplace_back();
+}
+
+void OSMGraphBuilder::add_way(OSMWay* way) {
+    //check for degenerate and repeated ways
+    if(way->node_ids.size() < 2 || !way_ids.insert(way->id).second) {
+        delete way;
+        return;
+    }
+    for(ll id : way->node_ids) {
+        if(!node_inds.count(id)) {
+            pending.push_back(way);
+            return;
+        }
+    }
+    add_edges(way);
+    delete way;
+}
+
+void OSMGraphBuilder::add_edges(OSMWay* way) {
+    bool is_driveable = way->is_driveable();
+    bool is_walkable = way->is_walkable();
+    int drive_dir = way->drive_dir();
+    int walk_dir = way->walk_dir();
+
+    bool is_driveable_forward = is_driveable && (drive_dir >= 0);
+    bool is_driveable_backward = is_driveable && (drive_dir <= 0);
+    bool is_walkable_forward = is_walkable && (walk_dir >= 0);
+    bool is_walkable_backward = is_walkable && (walk_dir <= 0);
+
+    ll prev = way->node_ids[0];
+    for(int i = 1; i < way->node_ids.size(); i++) {
+        ll next = way->node_ids[i];
+        ll u = node_inds.at(prev), v = node_inds.at(next);
+
+        //add edges
+        Edge *e1 = g->arena.make<Edge>(u, v, calc_dist(nodes[u]->coord, nodes[v]->coord), -1, is_driveable_forward, is_walkable_forward);
+        adj[u].push_back(e1);
+        Edge *e2 = g->arena.make<Edge>(v, u, calc_dist(nodes[u]->coord, nodes[v]->coord), -1, is_driveable_backward, is_walkable_backward);
+        adj[v].push_back(e2);
+        
+        //upd node walkable/driveable status
+        nodes[u]->is_driveable |= is_driveable_forward;
+        nodes[v]->is_driveable |= is_driveable_backward;
+        nodes[u]->is_walkable |= is_walkable_forward;
+        nodes[v]->is_walkable |= is_walkable_backward;
+
+        prev = next;
+    }
+}
+
+Graph* OSMGraphBuilder::build() {
+    for(OSMWay* way : pending) {
+        for(ll id : way->node_ids) {
+            if(!node_inds.count(id)) {
+                throw std::runtime_error("Graph::parse_osm() : way " + std::to_string(way->id) + " references missing node " + std::to_string(id));
+            }
+        }
+        add_edges(way);
+        delete way;
+    }
+    pending.clear();
+
+    //renumber by osm id
+    int n = nodes.size();
+    std::vector<int> order(n), new_ind(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return osm_ids[a] < osm_ids[b]; });
+    for(int i = 0; i < n; i++) new_ind[order[i]] = i;
+
+    g->nodes.resize(n);
+    g->adj.resize(n);
+    for(int i = 0; i < n; i++) {
+        g->nodes[new_ind[i]] = nodes[i];
+        nodes[i]->id = new_ind[i];
+        for(Edge* e : adj[i]) {
+            e->u = new_ind[e->u];
+            e->v = new_ind[e->v];
+        }
+        g->adj[new_ind[i]] = std::move(adj[i]);
+    }
+    nodes.clear();
+    adj.clear();
+    osm_ids.clear();
+    node_inds.clear();
+    way_ids.clear();
+
+    Graph* ret = g;
+    g = nullptr;
+    if(Graph::prune_fragments_on_parse) ret->prune_fragments();
+    if(Graph::contract_chains_on_parse) ret->contract_chains();
+    if(Graph::reorder_nodes_on_parse) ret->reorder_nodes();
+    ret->build_csr();
+    ret->build_spatial_index();
+    return ret;
+}
+
+namespace {
+
+//sax handler for {"elements" : [{"type" : .., "id" : .., "lat" : .., "lon" : .., "nodes" : [..], "tags" : {..}}, ..]}. 
+//depth 1 is the response object, 2 the elements array, 3 an element and 4 its nodes or tags. 
+//anything else, like overpass's osm3s header or relation members, is skipped
+struct OverpassSax : nlohmann::json_sax<json> {
+    OSMGraphBuilder& builder;
+    std::string* remark;
+
+    int depth = 0;
+    bool in_elements = false, in_nodes = false, in_tags = false;
+    std::string top_key, elem_key, tag_key;
+
+    //fields of the current element
+    std::string type;
+    ll id = 0;
+    ld lat = 0, lon = 0;
+    std::vector<ll> node_ids;
+    WayTags tags;
+
+    OverpassSax(OSMGraphBuilder& _builder, std::string* _remark) : builder(_builder), remark(_remark) {}
+
+    bool number(ld x) {
+        if(depth == 3 && in_elements) {
+            if(elem_key == "id") id = (ll) x;
+            else if(elem_key == "lat") lat = x;
+            else if(elem_key == "lon") lon = x;
+        }
+        return true;
+    }
+
+    bool integer(ll x) {
+        if(depth == 4 && in_nodes) node_ids.push_back(x);
+        else if(depth == 3 && in_elements && elem_key == "id") id = x;
+        else number(x);
+        return true;
+    }
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t x) override { return integer(x); }
+    bool number_unsigned(number_unsigned_t x) override { return integer(x); }
+    bool number_float(number_float_t x, const string_t&) override { return number(x); }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t& s) override {
+        if(depth == 1 && top_key == "remark" && remark != nullptr) *remark = s;
+        else if(depth == 3 && in_elements && elem_key == "type") type = s;
+        else if(depth == 4 && in_tags) tags.set(tag_key, s);
+        return true;
+    }
+
+    bool key(string_t& s) override {
+        if(depth == 1) top_key = s;
+        else if(depth == 3) elem_key = s;
+        else if(depth == 4 && in_tags) tag_key = s;
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        depth ++;
+        if(depth == 3 && in_elements) {
+            type.clear();
+            id = 0, lat = 0, lon = 0;
+            node_ids.clear();
+            tags = WayTags();
+        }
+        else if(depth == 4 && in_elements && elem_key == "tags") in_tags = true;
+        return true;
+    }
+
+    bool end_object() override {
+        if(depth == 3 && in_elements) {
+            if(type == "node") builder.add_node(id, lat, lon);
+            else if(type == "way") builder.add_way(new OSMWay(id, node_ids, tags));
+        }
+        else if(depth == 4) in_tags = false;
+        depth --;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        depth ++;
+        if(depth == 2 && top_key == "elements") in_elements = true;
+        else if(depth == 4 && in_elements && elem_key == "nodes") in_nodes = true;
+        return true;
+    }
+
+    bool end_array() override {
+        if(depth == 2) in_elements = false;
+        else if(depth == 4) in_nodes = false;
+        depth --;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+        throw std::runtime_error("parse_overpass_stream() : malformed json at byte " + std::to_string(position) + ", " + e.what());
+    }
+};
+
+}
+
+void parse_overpass_stream(std::istream& in, OSMGraphBuilder& builder, std::string* remark) {
+    OverpassSax sax(builder, remark);
+    json::sax_parse(in, &sax);
+}
+
+void parse_overpass_stream(const std::string& body, OSMGraphBuilder& builder, std::string* remark) {
+    OverpassSax sax(builder, remark);
+    json::sax_parse(body, &sax);
+}
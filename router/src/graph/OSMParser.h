@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <istream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Graph.h"
+
+//builds the road graph one osm element at a time, so a caller can feed it while a response 
+//is still being read. a way whose nodes have all been seen becomes edges right away, others 
+//are held until build(). nodes end up numbered in order of osm id, the same graph parse_osm 
+//has always produced for the same elements. 
+struct OSMGraphBuilder {
+    //the graph under construction, its arena holds the nodes and edges made so far
+    Graph* g;
+
+    std::vector<ll> osm_ids;        //osm id of each node, in arrival order
+    std::vector<Node*> nodes;
+    std::unordered_map<ll, int> node_inds;
+    std::vector<std::vector<Edge*>> adj;
+
+    //ways that arrived before some of their nodes
+    std::vector<OSMWay*> pending;
+    std::unordered_set<ll> way_ids;
+
+    OSMGraphBuilder() : g(new Graph()) {}
+    ~OSMGraphBuilder();
+
+    //a repeated id keeps the first copy
+    void add_node(ll id, ld lat, ld lon);
+
+    //takes ownership of way
+    void add_way(OSMWay* way);
+
+    //resolves pending ways, renumbers nodes and runs the usual post processing. 
+    //the builder is spent afterwards
+    Graph* build();
+
+private:
+    void add_edges(OSMWay* way);
+};
+
+//feeds every node and way of an overpass json response to builder without building the json dom. 
+//if remark isn't null it receives overpass's remark, which is set when the query hit a limit and 
+//the elements are incomplete
+void parse_overpass_stream(std::istream& in, OSMGraphBuilder& builder, std::string* remark = nullptr);
+void parse_overpass_stream(const std::string& body, OSMGraphBuilder& builder, std::string* remark = nullptr);
@@ -0,0 +1,56 @@
+#include "OSMTags.h"
+
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+enum Key { HIGHWAY, MOTOR_VEHICLE, MOTORCAR, VEHICLE, FOOT, ONEWAY, ONEWAY_FOOT, JUNCTION, CONVEYING, AREA };
+
+WayTags::Access to_access(std::string_view v) {
+    if(v == "yes") return WayTags::ACCESS_YES;
+    if(v == "no") return WayTags::ACCESS_NO;
+    return WayTags::ACCESS_UNSET;
+}
+
+WayTags::Direction to_oneway(std::string_view v) {
+    if(v == "yes" || v == "true" || v == "1") return WayTags::DIR_FORWARD;
+    if(v == "-1") return WayTags::DIR_BACKWARD;
+    if(v == "no" || v == "false" || v == "0") return WayTags::DIR_BOTH;
+    return WayTags::DIR_UNSET;
+}
+
+}
+
+void WayTags::set(std::string_view key, std::string_view value) {
+    static const std::unordered_map<std::string_view, Key> keys = {
+        {"highway", HIGHWAY}, {"motor_vehicle", MOTOR_VEHICLE}, {"motorcar", MOTORCAR}, {"vehicle", VEHICLE}, 
+        {"foot", FOOT}, {"oneway", ONEWAY}, {"oneway:foot", ONEWAY_FOOT}, {"junction", JUNCTION}, 
+        {"conveying", CONVEYING}, {"area", AREA}
+    };
+    static const std::unordered_map<std::string_view, Highway> highways = {
+        {"construction", HW_CONSTRUCTION}, {"proposed", HW_PROPOSED}, {"motorway", HW_MOTORWAY}, 
+        {"footway", HW_FOOTWAY}, {"path", HW_PATH}, {"pedestrian", HW_PEDESTRIAN}, {"steps", HW_STEPS}, 
+        {"bridleway", HW_BRIDLEWAY}, {"cycleway", HW_CYCLEWAY}, {"corridor", HW_CORRIDOR}
+    };
+
+    auto k = keys.find(key);
+    if(k == keys.end()) return;
+    switch(k->second) {
+        case HIGHWAY: {
+            auto h = highways.find(value);
+            highway = value.empty() ? HW_NONE : h == highways.end() ? HW_OTHER : h->second;
+            highway_link = value.size() > 5 && value.substr(value.size() - 5) == "_link";
+            break;
+        }
+        case MOTOR_VEHICLE: motor_vehicle = to_access(value); break;
+        case MOTORCAR: motorcar = to_access(value); break;
+        case VEHICLE: vehicle = to_access(value); break;
+        case FOOT: foot = to_access(value); break;
+        case ONEWAY: oneway = to_oneway(value); break;
+        case ONEWAY_FOOT: oneway_foot = to_oneway(value); break;
+        case JUNCTION: roundabout = value == "roundabout" || value == "circular"; break;
+        case CONVEYING: conveying = value == "forward" ? DIR_FORWARD : value == "backward" ? DIR_BACKWARD : DIR_UNSET; break;
+        case AREA: area = value == "yes"; break;
+    }
+}
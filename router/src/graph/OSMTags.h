@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+//the few osm way tags the road classification reads, interned into bits while parsing so no 
+//copy of a way's tags is kept. values the classification treats alike share a code, e.g. every 
+//access value other than yes and no reads as unset. 
+struct WayTags {
+    enum Highway : uint8_t {
+        HW_NONE, HW_OTHER, HW_CONSTRUCTION, HW_PROPOSED, HW_MOTORWAY, 
+        HW_FOOTWAY, HW_PATH, HW_PEDESTRIAN, HW_STEPS, HW_BRIDLEWAY, HW_CYCLEWAY, HW_CORRIDOR
+    };
+    enum Access : uint8_t { ACCESS_UNSET, ACCESS_YES, ACCESS_NO };
+    enum Direction : uint8_t { DIR_UNSET, DIR_FORWARD, DIR_BACKWARD, DIR_BOTH };
+
+    uint32_t highway : 4;
+    uint32_t highway_link : 1;      //highway value ends in _link
+    uint32_t motor_vehicle : 2, motorcar : 2, vehicle : 2, foot : 2;
+    uint32_t oneway : 2, oneway_foot : 2;
+    uint32_t conveying : 2;         //forward or backward
+    uint32_t roundabout : 1;        //junction is roundabout or circular
+    uint32_t area : 1;              //area=yes
+
+    WayTags() : highway(HW_NONE), highway_link(0), motor_vehicle(ACCESS_UNSET), motorcar(ACCESS_UNSET), vehicle(ACCESS_UNSET), 
+        foot(ACCESS_UNSET), oneway(DIR_UNSET), oneway_foot(DIR_UNSET), conveying(DIR_UNSET), roundabout(0), area(0) {}
+
+    //records one tag, keys the classification doesn't use are ignored
+    void set(std::string_view key, std::string_view value);
+};
@@ -0,0 +1,176 @@
+#include "PathCache.h"
+
+size_t PathCache::default_budget_bytes = (size_t) 256 << 20;
+
+PathCache::PathCache(size_t _budget_bytes) {
+    budget_bytes = _budget_bytes;
+    used_bytes = 0;
+    hits = 0, misses = 0, evictions = 0;
+    hand = 0;
+}
+
+PathCache::PathCache(const PathCache& o) : PathCache(o.budget_bytes) {
+    *this = o;
+}
+
+PathCache& PathCache::operator=(const PathCache& o) {
+    if(this == &o) return *this;
+    std::scoped_lock lock(mtx, o.mtx);
+    budget_bytes = o.budget_bytes;
+    used_bytes = o.used_bytes.load();
+    hits = o.hits.load(), misses = o.misses.load(), evictions = o.evictions.load();
+    slots = o.slots;
+    resident = o.resident;
+    hand = o.hand;
+    return *this;
+}
+
+void PathCache::resize(int n) {
+    std::lock_guard<std::mutex> lock(mtx);
+    slots.assign(2 * (size_t) n, nullptr);
+    resident.clear();
+    in_flight.clear();
+    used_bytes = 0;
+    hand = 0;
+}
+
+PathCache::RowPtr PathCache::load(ll key) const {
+    if(key < 0 || key >= (ll) slots.size()) return nullptr;
+    return std::atomic_load(&slots[key]);
+}
+
+PathCache::RowPtr PathCache::find(int source, bool walkable) {
+    RowPtr row = load(make_key(source, walkable));
+    if(row == nullptr) {
+        misses ++;
+        return nullptr;
+    }
+    hits ++;
+    row->referenced = true;
+    return row;
+}
+
+PathCache::RowPtr PathCache::peek(int source, bool walkable) {
+    RowPtr row = load(make_key(source, walkable));
+    if(row == nullptr) return nullptr;
+    hits ++;
+    row->referenced = true;
+    return row;
+}
+
+PathCache::RowPtr PathCache::get_or_compute(int source, bool walkable, const std::function<void(std::vector<ld>&, std::vector<int>&)>& compute) {
+    ll key = make_key(source, walkable);
+    assert(0 <= key && key < (ll) slots.size());
+    RowPtr row = find(source, walkable);
+    if(row != nullptr) return row;
+
+    //either join the computation already running for this key or become its owner
+    std::promise<RowPtr> promise;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        row = load(key);
+        if(row != nullptr) return row;
+        auto it = in_flight.find(key);
+        if(it != in_flight.end()) {
+            std::shared_future<RowPtr> fut = it->second;
+            lock.unlock();
+            return fut.get();
+        }
+        in_flight[key] = promise.get_future().share();
+    }
+
+    try {
+        std::shared_ptr<Row> fresh = std::make_shared<Row>();
+        fresh->key = key;
+        compute(fresh->dist, fresh->prev);
+        row = fresh;
+    }
+    catch(...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        in_flight.erase(key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        publish(row);
+        in_flight.erase(key);
+    }
+    promise.set_value(row);
+    return row;
+}
+
+PathCache::RowPtr PathCache::insert(int source, bool walkable, std::vector<ld>&& dist, std::vector<int>&& prev) {
+    std::shared_ptr<Row> row = std::make_shared<Row>();
+    row->key = make_key(source, walkable);
+    row->dist = std::move(dist);
+    row->prev = std::move(prev);
+    assert(0 <= row->key && row->key < (ll) slots.size());
+
+    std::lock_guard<std::mutex> lock(mtx);
+    publish(row);
+    return row;
+}
+
+void PathCache::publish(const RowPtr& row) {
+    //replace an existing row with the same key
+    RowPtr old = load(row->key);
+    if(old != nullptr) {
+        used_bytes -= old->bytes();
+    }
+    else {
+        while(used_bytes + row->bytes() > budget_bytes && evict_one());
+        resident.push_back(row->key);
+    }
+    used_bytes += row->bytes();
+    std::atomic_store(&slots[row->key], row);
+}
+
+bool PathCache::evict_one() {
+    if(resident.size() == 0) return false;
+
+    //sweep the clock hand, giving referenced rows a second chance
+    while(true) {
+        if(hand >= resident.size()) hand = 0;
+        RowPtr row = load(resident[hand]);
+        if(row->referenced) {
+            row->referenced = false;
+            hand ++;
+            continue;
+        }
+
+        used_bytes -= row->bytes();
+        std::atomic_store(&slots[row->key], RowPtr());
+        resident[hand] = resident.back();
+        resident.pop_back();
+        evictions ++;
+        return true;
+    }
+}
+
+void PathCache::set_budget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    budget_bytes = bytes;
+    while(used_bytes > budget_bytes && evict_one());
+}
+
+void PathCache::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for(ll key : resident) std::atomic_store(&slots[key], RowPtr());
+    resident.clear();
+    used_bytes = 0;
+    hand = 0;
+}
+
+size_t PathCache::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return resident.size();
+}
+
+std::vector<PathCache::RowPtr> PathCache::rows() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<RowPtr> ret;
+    for(ll key : resident) ret.push_back(load(key));
+    return ret;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <unordered_map>
+
+#include "../defs.h"
+
+//bounded store of single source shortest path rows, keyed by (source, travel mode). 
+//once the byte budget is exceeded rows are evicted with the CLOCK (second chance) policy, 
+//so memory stays flat no matter how many distinct sources get queried. 
+//
+//safe to share between threads. published rows are immutable and handed out as shared pointers, 
+//so a reader keeps its row alive even if it is evicted meanwhile. lookups read the slot table 
+//without taking a lock, only inserts and evictions serialize on a mutex. 
+struct PathCache {
+    //one cached sssp result
+    struct Row {
+        ll key = -1;
+        mutable std::atomic<bool> referenced{true};
+        std::vector<ld> dist;
+        std::vector<int> prev;
+
+        size_t bytes() const { return dist.size() * sizeof(ld) + prev.size() * sizeof(int); }
+    };
+    typedef std::shared_ptr<const Row> RowPtr;
+
+    //budget given to newly constructed caches, settable from the command line
+    static size_t default_budget_bytes;
+
+    size_t budget_bytes;
+    std::atomic<size_t> used_bytes;
+
+    //statistics
+    std::atomic<ll> hits, misses, evictions;
+
+    PathCache(size_t _budget_bytes = default_budget_bytes);
+
+    //copies share the immutable rows
+    PathCache(const PathCache& o);
+    PathCache& operator=(const PathCache& o);
+
+    static ll make_key(int source, bool walkable) {
+        return ((ll) source << 1) | (walkable ? 1 : 0);
+    }
+
+    //sizes the slot table for sources in [0, n), dropping every row. not thread safe, 
+    //call it while the graph is being built
+    void resize(int n);
+
+    //returns the cached row, or nullptr if it isn't present. counts as a hit / miss
+    RowPtr find(int source, bool walkable);
+
+    //same as find, but an absent row isn't counted as a miss. for callers that answer from some 
+    //other search when the row isn't there rather than computing it
+    RowPtr peek(int source, bool walkable);
+
+    //returns the cached row, computing it with compute(dist, prev) on a miss. 
+    //concurrent callers asking for the same missing row wait for a single computation
+    RowPtr get_or_compute(int source, bool walkable, const std::function<void(std::vector<ld>&, std::vector<int>&)>& compute);
+
+    //stores a freshly computed row, evicting others as needed to respect the budget. 
+    //a single row larger than the budget is still admitted so that callers can read it. 
+    RowPtr insert(int source, bool walkable, std::vector<ld>&& dist, std::vector<int>&& prev);
+
+    //drops rows until used_bytes fits in the new budget
+    void set_budget(size_t bytes);
+    void clear();
+
+    size_t size() const;
+
+    //all cached rows, for serialization
+    std::vector<RowPtr> rows() const;
+
+private:
+    //slot table indexed by key, read with atomic loads
+    std::vector<RowPtr> slots;
+
+    //guards everything below and all writes to slots
+    mutable std::mutex mtx;
+    std::vector<ll> resident;       //keys of cached rows in clock order
+    size_t hand;
+
+    //rows being computed by get_or_compute
+    std::unordered_map<ll, std::shared_future<RowPtr>> in_flight;
+
+    RowPtr load(ll key) const;
+
+    //both expect mtx to be held
+    void publish(const RowPtr& row);
+    bool evict_one();
+};
@@ -0,0 +1,479 @@
+#include "Graph.h"
+#include "../config.h"
+
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+#if !_ISWASM
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+//file layout : header, then a list of sections. each section is a tag, its byte size and a sequence 
+//of arrays, every array being its element count followed by the raw elements padded to 8 bytes. 
+//readers skip sections with tags they don't know, so sections can be added without a version bump. 
+namespace {
+
+const char MAGIC[8] = {'B', 'R', 'P', 'G', 'R', 'A', 'P', 'H'};
+const uint32_t VERSION = 2;
+
+enum Section : uint32_t {
+    NODES = 1,          //lat, lon, flags
+    EDGES = 2,          //adj flattened by source : offset, v, dist, speed_limit, flags, geometry offset, geometry lat, lon
+    WALK_CSR = 3,       //offset, target, weight
+    DRIVE_CSR = 4,
+    //5 held the spatial indexes with interleaved xyz, it is skipped and the indexes rebuilt
+    DRIVE_CH = 6,       //n, rank, up_offset, up_target, up_mid, up_weight, down_offset, down_source, down_mid, down_weight
+    SPATIAL_INDEX = 7,  //ids, x, y, z of walk_index, drive_index, node_index
+    WALK_ALT = 8,       //n, nodes, from, to
+    DRIVE_ALT = 9,
+};
+
+const uint8_t WALK_FLAG = 1, DRIVE_FLAG = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t ld_size;   //sizeof(ld) on the writing machine
+    uint64_t nr_sections;
+    double min_lat, min_lon, max_lat, max_lon;  //box the graph covers, added in version 2
+};
+
+struct SnapshotWriter {
+    std::ofstream out;
+    std::streampos section_start;
+    uint64_t nr_sections = 0;
+
+    void raw(const void* data, size_t bytes) {
+        out.write((const char*) data, bytes);
+        static const char zero[8] = {};
+        if(bytes % 8) out.write(zero, 8 - bytes % 8);
+    }
+
+    template<class T>
+    void array(const std::vector<T>& v) {
+        uint64_t size = v.size();
+        out.write((const char*) &size, sizeof(size));
+        raw(v.data(), v.size() * sizeof(T));
+    }
+
+    void begin(Section tag) {
+        uint32_t t = tag, pad = 0;
+        uint64_t size = 0;
+        out.write((const char*) &t, sizeof(t));
+        out.write((const char*) &pad, sizeof(pad));
+        out.write((const char*) &size, sizeof(size));
+        section_start = out.tellp();
+    }
+
+    //patches the byte size in front of the section
+    void end() {
+        std::streampos section_end = out.tellp();
+        uint64_t size = section_end - section_start;
+        out.seekp(section_start - (std::streamoff) sizeof(size));
+        out.write((const char*) &size, sizeof(size));
+        out.seekp(section_end);
+        nr_sections ++;
+    }
+};
+
+struct SnapshotReader {
+    const char* ptr;
+    const char* end;
+
+    void need(size_t bytes) {
+        if((size_t) (end - ptr) < bytes) throw std::runtime_error("Graph::read_snapshot() : snapshot truncated");
+    }
+
+    template<class T>
+    T value() {
+        need(sizeof(T));
+        T ret;
+        std::memcpy(&ret, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return ret;
+    }
+
+    template<class T>
+    void array(std::vector<T>& v) {
+        uint64_t size = value<uint64_t>();
+        size_t bytes = size * sizeof(T);
+        if(size > (uint64_t) (end - ptr) / sizeof(T)) throw std::runtime_error("Graph::read_snapshot() : snapshot truncated");
+        v.resize(size);
+        std::memcpy(v.data(), ptr, bytes);
+        ptr += (bytes + 7) / 8 * 8;
+    }
+};
+
+//read only view of a whole file, memory mapped where that is available
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> buffer;
+    bool mapped = false;
+
+    MappedFile(const std::string& filepath) {
+#if !_ISWASM
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("Graph::read_snapshot() : cannot open " + filepath);
+        struct stat st;
+        if(fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Graph::read_snapshot() : cannot stat " + filepath);
+        }
+        size = st.st_size;
+        if(size > 0) {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED) {
+                data = (const char*) p;
+                mapped = true;
+            }
+        }
+        close(fd);
+        if(mapped || size == 0) return;
+#endif
+        std::ifstream in(filepath, std::ios::binary);
+        if(!in) throw std::runtime_error("Graph::read_snapshot() : cannot open " + filepath);
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+    }
+
+    ~MappedFile() {
+#if !_ISWASM
+        if(mapped) munmap((void*) data, size);
+#endif
+    }
+};
+
+void check(bool ok, const std::string& what) {
+    if(!ok) throw std::runtime_error("Graph::read_snapshot() : malformed " + what);
+}
+
+//n + 1 offsets starting at 0, never decreasing and ending at size
+bool valid_offsets(const std::vector<int>& offset, int n, size_t size) {
+    if(offset.size() != (size_t) n + 1 || offset[0] != 0 || (size_t) offset[n] != size) return false;
+    for(int u = 0; u < n; u++) {
+        if(offset[u] > offset[u + 1]) return false;
+    }
+    return true;
+}
+
+//every element in [lo, hi)
+bool in_range(const std::vector<int>& v, int lo, int hi) {
+    for(int x : v) {
+        if(x < lo || x >= hi) return false;
+    }
+    return true;
+}
+
+bool valid_csr(const CSR& g, int n) {
+    return valid_offsets(g.offset, n, g.target.size()) && g.weight.size() == g.target.size() && in_range(g.target, 0, n);
+}
+
+bool valid_ch(const ContractionHierarchy& ch, int n) {
+    if(ch.n != n || ch.rank.size() != n || !in_range(ch.rank, 0, n)) return false;
+    std::vector<bool> seen(n, false);
+    for(int r : ch.rank) {
+        if(seen[r]) return false;
+        seen[r] = true;
+    }
+    size_t up = ch.up_target.size(), down = ch.down_source.size();
+    return valid_offsets(ch.up_offset, n, up) && ch.up_mid.size() == up && ch.up_weight.size() == up 
+        && in_range(ch.up_target, 0, n) && in_range(ch.up_mid, -1, n) 
+        && valid_offsets(ch.down_offset, n, down) && ch.down_mid.size() == down && ch.down_weight.size() == down 
+        && in_range(ch.down_source, 0, n) && in_range(ch.down_mid, -1, n);
+}
+
+void write_csr(SnapshotWriter& w, const CSR& g) {
+    w.array(g.offset);
+    w.array(g.target);
+    w.array(g.weight);
+}
+
+void read_csr(SnapshotReader& r, CSR& g) {
+    r.array(g.offset);
+    r.array(g.target);
+    r.array(g.weight);
+}
+
+void write_landmarks(SnapshotWriter& w, const Landmarks& alt) {
+    w.array(std::vector<int>{alt.n});
+    w.array(alt.nodes);
+    w.array(alt.from);
+    w.array(alt.to);
+}
+
+Landmarks* read_landmarks(SnapshotReader& r) {
+    std::unique_ptr<Landmarks> alt(new Landmarks());
+    std::vector<int> n;
+    r.array(n);
+    r.array(alt->nodes);
+    r.array(alt->from);
+    r.array(alt->to);
+    check(n.size() == 1, "landmarks");
+    alt->n = n[0];
+    alt->k = alt->nodes.size();
+    size_t size = (size_t) alt->n * alt->k;
+    check(alt->from.size() == size && alt->to.size() == size, "landmarks");
+    return alt.release();
+}
+
+}
+
+void Graph::write_snapshot(const std::string& filepath) {
+    SnapshotWriter w;
+    w.out.open(filepath, std::ios::binary | std::ios::trunc);
+    if(!w.out) throw std::runtime_error("Graph::write_snapshot() : cannot open " + filepath);
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.ld_size = sizeof(ld);
+    header.nr_sections = 0;
+    header.min_lat = min_lat, header.min_lon = min_lon, header.max_lat = max_lat, header.max_lon = max_lon;
+    int n = nodes.size();
+    assert(node_pos.size() == n);
+    if(min_lat > max_lat || min_lon > max_lon) {
+        for(int i = 0; i < n; i++) {
+            header.min_lat = std::min(header.min_lat, (double) node_pos.lat[i]);
+            header.min_lon = std::min(header.min_lon, (double) node_pos.lon[i]);
+            header.max_lat = std::max(header.max_lat, (double) node_pos.lat[i]);
+            header.max_lon = std::max(header.max_lon, (double) node_pos.lon[i]);
+        }
+    }
+    w.out.write((const char*) &header, sizeof(header));
+
+    {
+        std::vector<uint8_t> flags(n);
+        for(int i = 0; i < n; i++) {
+            flags[i] = (nodes[i]->is_walkable ? WALK_FLAG : 0) | (nodes[i]->is_driveable ? DRIVE_FLAG : 0);
+        }
+        w.begin(NODES);
+        w.array(node_pos.lat);
+        w.array(node_pos.lon);
+        w.array(flags);
+        w.end();
+    }
+
+    {
+        std::vector<int> offset(n + 1, 0), v, geom_offset(1, 0);
+        std::vector<ld> dist, speed_limit, geom_lat, geom_lon;
+        std::vector<uint8_t> flags;
+        for(int u = 0; u < n; u++) {
+            for(Edge* e : adj[u]) {
+                v.push_back(e->v);
+                dist.push_back(e->dist);
+                speed_limit.push_back(e->speed_limit);
+                flags.push_back((e->is_walkable ? WALK_FLAG : 0) | (e->is_driveable ? DRIVE_FLAG : 0));
+                for(Coordinate* c : e->geometry) {
+                    geom_lat.push_back(c->lat);
+                    geom_lon.push_back(c->lon);
+                }
+                geom_offset.push_back(geom_lat.size());
+            }
+            offset[u + 1] = v.size();
+        }
+        w.begin(EDGES);
+        w.array(offset);
+        w.array(v);
+        w.array(dist);
+        w.array(speed_limit);
+        w.array(flags);
+        w.array(geom_offset);
+        w.array(geom_lat);
+        w.array(geom_lon);
+        w.end();
+    }
+
+    w.begin(WALK_CSR);
+    write_csr(w, walk_csr);
+    w.end();
+    w.begin(DRIVE_CSR);
+    write_csr(w, drive_csr);
+    w.end();
+
+    w.begin(SPATIAL_INDEX);
+    for(const SpatialIndex* index : {&walk_index, &drive_index, &node_index}) {
+        w.array(index->ids);
+        w.array(index->x);
+        w.array(index->y);
+        w.array(index->z);
+    }
+    w.end();
+
+    ContractionHierarchy* ch = drive_ch.load();
+    if(ch != nullptr) {
+        w.begin(DRIVE_CH);
+        w.array(std::vector<int>{ch->n});
+        w.array(ch->rank);
+        w.array(ch->up_offset);
+        w.array(ch->up_target);
+        w.array(ch->up_mid);
+        w.array(ch->up_weight);
+        w.array(ch->down_offset);
+        w.array(ch->down_source);
+        w.array(ch->down_mid);
+        w.array(ch->down_weight);
+        w.end();
+    }
+
+    Landmarks* walk = walk_alt.load();
+    if(walk != nullptr) {
+        w.begin(WALK_ALT);
+        write_landmarks(w, *walk);
+        w.end();
+    }
+    Landmarks* drive = drive_alt.load();
+    if(drive != nullptr) {
+        w.begin(DRIVE_ALT);
+        write_landmarks(w, *drive);
+        w.end();
+    }
+
+    header.nr_sections = w.nr_sections;
+    w.out.seekp(0);
+    w.out.write((const char*) &header, sizeof(header));
+    if(!w.out) throw std::runtime_error("Graph::write_snapshot() : failed writing " + filepath);
+    std::cout << "WROTE GRAPH SNAPSHOT : " << filepath << std::endl;
+}
+
+Graph* Graph::read_snapshot(const std::string& filepath) {
+    MappedFile file(filepath);
+    SnapshotReader r{file.data, file.data + file.size};
+
+    Header header = r.value<Header>();
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("Graph::read_snapshot() : not a graph snapshot");
+    if(header.version != VERSION) throw std::runtime_error("Graph::read_snapshot() : unsupported snapshot version " + std::to_string(header.version));
+    if(header.ld_size != sizeof(ld)) throw std::runtime_error("Graph::read_snapshot() : snapshot was written with a different ld type");
+
+    //freed if the snapshot turns out to be malformed
+    std::unique_ptr<Graph> g(new Graph());
+    g->min_lat = header.min_lat, g->min_lon = header.min_lon, g->max_lat = header.max_lat, g->max_lon = header.max_lon;
+    bool has_nodes = false, has_edges = false, has_walk = false, has_drive = false, has_index = false;
+    for(uint64_t s = 0; s < header.nr_sections; s++) {
+        uint32_t tag = r.value<uint32_t>();
+        r.value<uint32_t>();
+        uint64_t size = r.value<uint64_t>();
+        r.need(size);
+        SnapshotReader sec{r.ptr, r.ptr + size};
+        r.ptr += size;
+
+        if(tag == NODES) {
+            std::vector<ld> lat, lon;
+            std::vector<uint8_t> flags;
+            sec.array(lat);
+            sec.array(lon);
+            sec.array(flags);
+            int n = lat.size();
+            if(lon.size() != n || flags.size() != n) throw std::runtime_error("Graph::read_snapshot() : malformed nodes");
+
+            g->nodes.resize(n);
+            for(int i = 0; i < n; i++) {
+                g->nodes[i] = g->arena.make<Node>(i, g->arena.make<Coordinate>(lat[i], lon[i]), flags[i] & WALK_FLAG, flags[i] & DRIVE_FLAG);
+            }
+            has_nodes = true;
+        }
+        else if(tag == EDGES) {
+            if(!has_nodes) throw std::runtime_error("Graph::read_snapshot() : edges before nodes");
+            std::vector<int> offset, v, geom_offset;
+            std::vector<ld> dist, speed_limit, geom_lat, geom_lon;
+            std::vector<uint8_t> flags;
+            sec.array(offset);
+            sec.array(v);
+            sec.array(dist);
+            sec.array(speed_limit);
+            sec.array(flags);
+            sec.array(geom_offset);
+            sec.array(geom_lat);
+            sec.array(geom_lon);
+            int n = g->nodes.size(), m = v.size();
+            check(valid_offsets(offset, n, m) && dist.size() == m && speed_limit.size() == m && flags.size() == m && in_range(v, 0, n), "edges");
+            check(valid_offsets(geom_offset, m, geom_lat.size()) && geom_lon.size() == geom_lat.size(), "edge geometry");
+
+            std::vector<Coordinate*> geom(geom_lat.size());
+            for(size_t i = 0; i < geom_lat.size(); i++) geom[i] = g->arena.make<Coordinate>(geom_lat[i], geom_lon[i]);
+            g->adj.assign(n, {});
+            for(int u = 0; u < n; u++) {
+                g->adj[u].reserve(offset[u + 1] - offset[u]);
+                for(int k = offset[u]; k < offset[u + 1]; k++) {
+                    Edge* e = g->arena.make<Edge>(u, v[k], dist[k], speed_limit[k], flags[k] & DRIVE_FLAG, flags[k] & WALK_FLAG);
+                    for(int x = geom_offset[k]; x < geom_offset[k + 1]; x++) e->geometry.push_back(geom[x]);
+                    g->adj[u].push_back(e);
+                }
+            }
+            has_edges = true;
+        }
+        else if(tag == WALK_CSR) {
+            read_csr(sec, g->walk_csr);
+            has_walk = true;
+        }
+        else if(tag == DRIVE_CSR) {
+            read_csr(sec, g->drive_csr);
+            has_drive = true;
+        }
+        else if(tag == SPATIAL_INDEX) {
+            for(SpatialIndex* index : {&g->walk_index, &g->drive_index, &g->node_index}) {
+                sec.array(index->ids);
+                sec.array(index->x);
+                sec.array(index->y);
+                sec.array(index->z);
+                size_t m = index->ids.size();
+                check(index->x.size() == m && index->y.size() == m && index->z.size() == m, "spatial index");
+            }
+            has_index = true;
+        }
+        else if(tag == DRIVE_CH) {
+            std::unique_ptr<ContractionHierarchy> ch(new ContractionHierarchy());
+            std::vector<int> n;
+            sec.array(n);
+            check(n.size() == 1, "contraction hierarchy");
+            ch->n = n[0];
+            sec.array(ch->rank);
+            sec.array(ch->up_offset);
+            sec.array(ch->up_target);
+            sec.array(ch->up_mid);
+            sec.array(ch->up_weight);
+            sec.array(ch->down_offset);
+            sec.array(ch->down_source);
+            sec.array(ch->down_mid);
+            sec.array(ch->down_weight);
+            delete g->drive_ch.load();
+            g->drive_ch = ch.release();
+        }
+        else if(tag == WALK_ALT || tag == DRIVE_ALT) {
+            std::atomic<Landmarks*>& slot = tag == WALK_ALT ? g->walk_alt : g->drive_alt;
+            delete slot.load();
+            slot = read_landmarks(sec);
+        }
+    }
+
+    if(!has_nodes || !has_edges) throw std::runtime_error("Graph::read_snapshot() : snapshot missing nodes or edges");
+    int n = g->nodes.size();
+    g->node_pos = NodePositions(g->nodes);
+    //every index stored in the file is checked before anything follows it
+    if(has_walk) check(valid_csr(g->walk_csr, n), "walk csr");
+    if(has_drive) check(valid_csr(g->drive_csr, n), "drive csr");
+    if(!has_walk || !has_drive) {
+        g->walk_csr = CSR(g->adj, true);
+        g->drive_csr = CSR(g->adj, false);
+    }
+    for(SpatialIndex* index : {&g->walk_index, &g->drive_index, &g->node_index}) check(in_range(index->ids, 0, n), "spatial index");
+    if(g->drive_ch != nullptr) check(valid_ch(*g->drive_ch.load(), n), "contraction hierarchy");
+    for(Landmarks* alt : {g->walk_alt.load(), g->drive_alt.load()}) {
+        if(alt != nullptr) check(alt->n == n && in_range(alt->nodes, 0, n), "landmarks");
+    }
+    g->walk_rcsr = g->walk_csr.transpose();
+    g->drive_rcsr = g->drive_csr.transpose();
+    g->walk_scc = Components(g->walk_csr);
+    g->drive_scc = Components(g->drive_csr);
+    g->cache.resize(n);
+    if(!has_index) g->build_spatial_index();
+
+    std::cout << "READ GRAPH SNAPSHOT : " << n << " nodes" << std::endl;
+    return g.release();
+}
@@ -0,0 +1,121 @@
+#include "SpatialIndex.h"
+#include "DistKernel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <queue>
+
+static void project(const Coordinate& c, double* out) {
+    double lat = (double) c.lat * (double) PI / 180.0;
+    double lon = (double) c.lon * (double) PI / 180.0;
+    out[0] = cos(lat) * cos(lon);
+    out[1] = cos(lat) * sin(lon);
+    out[2] = sin(lat);
+}
+
+SpatialIndex::SpatialIndex(const std::vector<Coordinate*>& coords, const std::vector<int>& _ids) {
+    assert(coords.size() == _ids.size());
+    ids = _ids;
+    int n = ids.size();
+    x.resize(n), y.resize(n), z.resize(n);
+    for(int i = 0; i < n; i++) {
+        double p[3];
+        project(*coords[i], p);
+        x[i] = p[0], y[i] = p[1], z[i] = p[2];
+    }
+    build(0, n, 0);
+}
+
+//puts the median along axis depth % 3 in the middle of [l, r), then recurses on both halves
+void SpatialIndex::build(int l, int r, int depth) {
+    if(r - l <= LEAF_SIZE) return;
+    int m = (l + r) / 2;
+    std::vector<double>& key = depth % 3 == 0 ? x : depth % 3 == 1 ? y : z;
+    std::vector<int> ord(r - l);
+    std::iota(ord.begin(), ord.end(), l);
+    std::nth_element(ord.begin(), ord.begin() + (m - l), ord.end(), [&](int a, int b) {
+        return key[a] < key[b];
+    });
+    auto permute = [&](auto& arr) {
+        std::vector<typename std::decay_t<decltype(arr)>::value_type> tmp(r - l);
+        for(int i = 0; i < r - l; i++) tmp[i] = arr[ord[i]];
+        std::copy(tmp.begin(), tmp.end(), arr.begin() + l);
+    };
+    permute(ids), permute(x), permute(y), permute(z);
+    build(l, m, depth + 1);
+    build(m + 1, r, depth + 1);
+}
+
+int SpatialIndex::nearest(const Coordinate& coord) const {
+    std::vector<int> res = k_nearest(coord, 1);
+    return res.size() ? res[0] : -1;
+}
+
+std::vector<int> SpatialIndex::k_nearest(const Coordinate& coord, int k) const {
+    std::vector<int> ret;
+    if(k <= 0 || ids.empty()) return ret;
+    double q[3];
+    project(coord, q);
+
+    //max heap of the best k found so far, (squared distance, position in tree order)
+    std::priority_queue<std::pair<double, int>> best;
+    auto offer = [&](double d, int i) {
+        if(best.size() < k) best.push({d, i});
+        else if(d < best.top().first) {
+            best.pop();
+            best.push({d, i});
+        }
+    };
+    double leaf_dist[LEAF_SIZE];
+
+    //explicit stack of subtrees, bound is a lower bound on the squared distance from q to any point in it
+    struct Range {
+        int l, r, depth;
+        double bound;
+    };
+    std::vector<Range> stk;
+    stk.push_back({0, (int) ids.size(), 0, 0});
+    while(stk.size()) {
+        auto [l, r, depth, bound] = stk.back();
+        stk.pop_back();
+        if(l >= r) continue;
+        if(best.size() == k && bound >= best.top().first) continue;
+        if(r - l <= LEAF_SIZE) {
+            chord_sq_dists(q, &x[l], &y[l], &z[l], r - l, leaf_dist);
+            for(int i = l; i < r; i++) offer(leaf_dist[i - l], i);
+            continue;
+        }
+        int m = (l + r) / 2, axis = depth % 3;
+        double dx = x[m] - q[0], dy = y[m] - q[1], dz = z[m] - q[2];
+        offer(dx * dx + dy * dy + dz * dz, m);
+
+        //push the side containing q last so it is searched first, 
+        //the far side is skipped once the splitting plane is further than the k-th best
+        double diff = q[axis] - (axis == 0 ? x : axis == 1 ? y : z)[m];
+        if(diff < 0) {
+            stk.push_back({m + 1, r, depth + 1, std::max(bound, diff * diff)});
+            stk.push_back({l, m, depth + 1, bound});
+        }
+        else {
+            stk.push_back({l, m, depth + 1, std::max(bound, diff * diff)});
+            stk.push_back({m + 1, r, depth + 1, bound});
+        }
+    }
+    
+    while(best.size()) {
+        ret.push_back(ids[best.top().second]);
+        best.pop();
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+}
+
+std::vector<int> SpatialIndex::nearest_batch(const std::vector<Coordinate>& coords) const {
+    std::vector<int> ret(coords.size());
+    ThreadPool::shared().parallel_for(coords.size(), [&](int i, int thread) {
+        ret[i] = nearest(coords[i]);
+    });
+    return ret;
+}
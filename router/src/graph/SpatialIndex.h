@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+
+#include "../defs.h"
+#include "../routing/Coordinate.h"
+
+//static k-d tree over a set of graph nodes for nearest node snapping. 
+//coordinates are projected onto the unit sphere, where straight line (chord) distance 
+//increases with great circle distance, so nearest by chord is nearest by haversine. 
+struct SpatialIndex {
+    //ranges of at most this many points are left unsplit and scanned as one block
+    static const int LEAF_SIZE = 16;
+
+    //points are stored in tree order, the root of [l, r) is at (l + r) / 2 unless [l, r) is a leaf.
+    //x, y and z are kept as separate arrays so that a leaf is three contiguous blocks
+    std::vector<int> ids;
+    std::vector<double> x, y, z;
+
+    SpatialIndex() {}
+    SpatialIndex(const std::vector<Coordinate*>& coords, const std::vector<int>& _ids);
+
+    int size() const { return ids.size(); }
+
+    //id of the closest point, -1 if the index is empty
+    int nearest(const Coordinate& coord) const;
+
+    //ids of the k closest points, closest first
+    std::vector<int> k_nearest(const Coordinate& coord, int k) const;
+
+    //nearest() of every coordinate, spread over the shared thread pool
+    std::vector<int> nearest_batch(const std::vector<Coordinate>& coords) const;
+
+private:
+    void build(int l, int r, int depth);
+};
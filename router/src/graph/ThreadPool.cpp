@@ -0,0 +1,93 @@
+#include "ThreadPool.h"
+#include "../config.h"
+
+int ThreadPool::default_threads = 0;
+
+//thread index while a thread is running part of a job, -1 otherwise. nested parallel_for calls run inline under it
+static thread_local int job_thread = -1;
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(default_threads);
+    return pool;
+}
+
+ThreadPool::ThreadPool(int _nr_threads) {
+    nr_threads = _nr_threads;
+    if(nr_threads <= 0) nr_threads = std::thread::hardware_concurrency();
+#if _ISWASM
+    //the wasm build has no pthreads
+    nr_threads = 1;
+#endif
+    if(nr_threads <= 0) nr_threads = 1;
+    for(int i = 1; i < nr_threads; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for(std::thread& t : workers) t.join();
+}
+
+void ThreadPool::run_job(int thread) {
+    job_thread = thread;
+    while(true) {
+        int i = next_index.fetch_add(1);
+        if(i >= job_size) break;
+        (*job)(i, thread);
+    }
+    job_thread = -1;
+}
+
+void ThreadPool::worker_loop(int thread) {
+    long long seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+        }
+        run_job(thread);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            active --;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(int n, const std::function<void(int, int)>& fn) {
+    if(n <= 0) return;
+    if(job_thread != -1) {
+        for(int i = 0; i < n; i++) fn(i, job_thread);
+        return;
+    }
+    if(nr_threads == 1 || n == 1) {
+        for(int i = 0; i < n; i++) fn(i, 0);
+        return;
+    }
+
+    //one job at a time, concurrent callers queue up here
+    std::lock_guard<std::mutex> job_lock(job_mtx);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        job_size = n;
+        next_index = 0;
+        active = workers.size();
+        generation ++;
+    }
+    work_cv.notify_all();
+
+    //the calling thread takes part as thread 0
+    run_job(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [&] { return active == 0; });
+    job = nullptr;
+}
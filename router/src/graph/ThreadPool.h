@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//fixed set of worker threads shared by the parallel shortest path code. 
+//threads are started once and reused, a job is a parallel for loop over [0, n). 
+struct ThreadPool {
+    //number of threads used by the shared pool, 0 means one per hardware thread. 
+    //settable from the command line, must be set before the first call to shared()
+    static int default_threads;
+
+    //the pool used by Graph and the algorithms, created on first use
+    static ThreadPool& shared();
+
+    //nr_threads counts the calling thread, so 1 runs everything inline
+    ThreadPool(int nr_threads);
+    ~ThreadPool();
+
+    int size() const { return nr_threads; }
+
+    //calls fn(i, thread) for every i in [0, n) and blocks until all calls have returned. 
+    //thread is in [0, size()) and no two concurrent calls share one, so it can index per-thread scratch. 
+    //jobs don't nest, a parallel_for issued from inside fn runs inline on the calling thread
+    void parallel_for(int n, const std::function<void(int, int)>& fn);
+
+private:
+    int nr_threads;
+    std::vector<std::thread> workers;
+
+    std::mutex mtx;
+    std::condition_variable work_cv, done_cv;
+    bool stopping = false;
+
+    //current job
+    std::mutex job_mtx;
+    const std::function<void(int, int)>* job = nullptr;
+    int job_size = 0;
+    long long generation = 0;
+    std::atomic<int> next_index{0};
+    int active = 0;
+
+    void worker_loop(int thread);
+    void run_job(int thread);
+};
@@ -0,0 +1,292 @@
+#include "OverpassCache.h"
+#include "../config.h"
+
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#if !_ISWASM
+    #include <filesystem>
+    #include <cerrno>
+    #include <cstdio>
+    #include <cstdlib>
+    #include <zlib.h>
+    #include <fcntl.h>
+    #include <sys/file.h>
+    #include <unistd.h>
+#endif
+
+std::string OverpassCache::dir = "";
+ld OverpassCache::ttl_hours = 24 * 7;
+size_t OverpassCache::max_bytes = (size_t) 1 << 30;
+std::mutex OverpassCache::mtx;
+
+bool OverpassCache::Entry::contains(ld _min_lat, ld _min_lon, ld _max_lat, ld _max_lon) const {
+    return min_lat <= _min_lat && min_lon <= _min_lon && max_lat >= _max_lat && max_lon >= _max_lon;
+}
+
+OverpassCache::Entry OverpassCache::Entry::parse(json& j) {
+    Entry e;
+    e.key = j.at("key").get<std::string>();
+    e.min_lat = j.at("min_lat").get<ld>();
+    e.min_lon = j.at("min_lon").get<ld>();
+    e.max_lat = j.at("max_lat").get<ld>();
+    e.max_lon = j.at("max_lon").get<ld>();
+    e.time = j.at("time").get<ll>();
+    e.bytes = j.at("bytes").get<ll>();
+    return e;
+}
+
+json OverpassCache::Entry::to_json() {
+    json j;
+    j["key"] = key;
+    j["min_lat"] = min_lat;
+    j["min_lon"] = min_lon;
+    j["max_lat"] = max_lat;
+    j["max_lon"] = max_lon;
+    j["time"] = time;
+    j["bytes"] = bytes;
+    return j;
+}
+
+std::string OverpassCache::hash(const std::string& query) {
+    unsigned long long h = 14695981039346656037ull;
+    for(unsigned char c : query) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    std::ostringstream out;
+    out << std::hex;
+    out.width(16);
+    out.fill('0');
+    out << h;
+    return out.str();
+}
+
+#if _ISWASM
+
+bool OverpassCache::find(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body) {
+    return false;
+}
+
+void OverpassCache::store(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body) {}
+
+bool OverpassCache::find_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body) { return false; }
+void OverpassCache::store_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body) {}
+std::string OverpassCache::path(const std::string& name) { return name; }
+std::vector<OverpassCache::Entry> OverpassCache::read_index() { return {}; }
+void OverpassCache::write_index(std::vector<Entry>& entries) {}
+bool OverpassCache::read_entry(const Entry& e, std::string& body) { return false; }
+void OverpassCache::drop_expired(std::vector<Entry>& entries) {}
+
+#else
+
+namespace {
+
+//exclusive lock on the cache directory, held across processes while the index is read, changed and 
+//written back, so that concurrent runs don't drop each other's entries
+struct DirLock {
+    int fd;
+
+    DirLock(const std::string& lock_file) {
+        fd = open(lock_file.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) throw std::runtime_error("OverpassCache : cannot open " + lock_file);
+        while(flock(fd, LOCK_EX) != 0) {
+            if(errno == EINTR) continue;
+            close(fd);
+            throw std::runtime_error("OverpassCache : cannot lock " + lock_file);
+        }
+    }
+
+    ~DirLock() {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+};
+
+//creates a uniquely named temporary file next to file and returns its descriptor, 
+//so that concurrent writers never share one
+int make_temp(const std::string& file, std::string& tmp) {
+    std::vector<char> name(file.begin(), file.end());
+    const std::string suffix = ".XXXXXX";
+    name.insert(name.end(), suffix.begin(), suffix.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if(fd < 0) throw std::runtime_error("OverpassCache : cannot create a temporary file for " + file);
+    tmp = name.data();
+    return fd;
+}
+
+}
+
+std::string OverpassCache::path(const std::string& name) {
+    return (std::filesystem::path(dir) / name).string();
+}
+
+std::vector<OverpassCache::Entry> OverpassCache::read_index() {
+    std::vector<Entry> entries;
+    std::ifstream in(path("index.json"));
+    if(!in) return entries;
+    try {
+        json j;
+        in >> j;
+        for(json& e : j) entries.push_back(Entry::parse(e));
+    }
+    catch(const std::exception& e) {
+        //a corrupt index only costs us the cache
+        std::cout << "OVERPASS CACHE : ignoring unreadable index, " << e.what() << "\n";
+        entries.clear();
+    }
+    return entries;
+}
+
+//written to a temporary file and renamed so a concurrent reader never sees half an index. 
+//callers hold the directory lock
+void OverpassCache::write_index(std::vector<Entry>& entries) {
+    json j = json::array();
+    for(Entry& e : entries) j.push_back(e.to_json());
+    std::string data = j.dump() + "\n", tmp;
+    FILE* out = fdopen(make_temp(path("index.json"), tmp), "w");
+    bool ok = out != nullptr && fwrite(data.data(), 1, data.size(), out) == data.size();
+    if(out == nullptr || fclose(out) != 0 || !ok) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("OverpassCache::write_index() : cannot write " + tmp);
+    }
+    std::filesystem::rename(tmp, path("index.json"));
+}
+
+bool OverpassCache::read_entry(const Entry& e, std::string& body) {
+    gzFile in = gzopen(path(e.key + ".json.gz").c_str(), "rb");
+    if(in == nullptr) return false;
+    body.clear();
+    char buf[1 << 16];
+    int len;
+    while((len = gzread(in, buf, sizeof(buf))) > 0) body.append(buf, len);
+    bool ok = len == 0;
+    gzclose(in);
+    return ok;
+}
+
+void OverpassCache::drop_expired(std::vector<Entry>& entries) {
+    ll now = std::time(nullptr);
+    std::vector<Entry> kept;
+    for(Entry& e : entries) {
+        std::string file = path(e.key + ".json.gz");
+        if((now - e.time) > ttl_hours * 3600 || !std::filesystem::exists(file)) {
+            std::error_code ec;
+            std::filesystem::remove(file, ec);
+        }
+        else kept.push_back(e);
+    }
+    entries = kept;
+}
+
+bool OverpassCache::find(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body) {
+    if(dir == "") return false;
+    try {
+        return find_entry(query, min_lat, min_lon, max_lat, max_lon, body);
+    }
+    catch(const std::exception& e) {
+        std::cout << "OVERPASS CACHE : lookup failed, going without the cache : " << e.what() << std::endl;
+        body.clear();
+        return false;
+    }
+}
+
+void OverpassCache::store(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body) {
+    if(dir == "") return;
+    try {
+        store_entry(query, min_lat, min_lon, max_lat, max_lon, body);
+    }
+    catch(const std::exception& e) {
+        std::cout << "OVERPASS CACHE : store failed, going without the cache : " << e.what() << std::endl;
+    }
+}
+
+bool OverpassCache::find_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!std::filesystem::exists(path("index.json"))) return false;
+    DirLock dir_lock(path("index.lock"));
+
+    std::vector<Entry> entries = read_index();
+    size_t nr_entries = entries.size();
+    drop_expired(entries);
+    if(entries.size() != nr_entries) write_index(entries);
+
+    //exact query first, otherwise the smallest box covering the requested one
+    std::string key = hash(query);
+    const Entry* best = nullptr;
+    for(const Entry& e : entries) {
+        if(e.key == key) {
+            best = &e;
+            break;
+        }
+        if(!e.contains(min_lat, min_lon, max_lat, max_lon)) continue;
+        if(best == nullptr || (e.max_lat - e.min_lat) * (e.max_lon - e.min_lon) < (best->max_lat - best->min_lat) * (best->max_lon - best->min_lon)) {
+            best = &e;
+        }
+    }
+    if(best == nullptr || !read_entry(*best, body)) {
+        std::cout << "OVERPASS CACHE : miss " << key << std::endl;
+        return false;
+    }
+    std::cout << "OVERPASS CACHE : hit " << best->key << (best->key == key ? "" : " (containing box)") << std::endl;
+    return true;
+}
+
+void OverpassCache::store_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body) {
+    std::filesystem::create_directories(dir);
+
+    Entry entry;
+    entry.key = hash(query);
+    entry.min_lat = min_lat, entry.min_lon = min_lon, entry.max_lat = max_lat, entry.max_lon = max_lon;
+    entry.time = std::time(nullptr);
+
+    //compressed into a temporary file of our own outside the lock, then renamed into place under it
+    std::string file = path(entry.key + ".json.gz"), tmp;
+    int fd = make_temp(file, tmp);
+    gzFile out = gzdopen(fd, "wb6");
+    if(out == nullptr) {
+        close(fd);
+        std::remove(tmp.c_str());
+        throw std::runtime_error("OverpassCache::store_entry() : cannot write " + tmp);
+    }
+    bool ok = body.empty() || gzwrite(out, body.data(), body.size()) == (int) body.size();
+    if(gzclose(out) != Z_OK || !ok) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("OverpassCache::store_entry() : failed writing " + tmp);
+    }
+    //mkstemp creates the file readable by its owner only
+    std::filesystem::permissions(tmp, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write | 
+                                 std::filesystem::perms::group_read | std::filesystem::perms::others_read);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    DirLock dir_lock(path("index.lock"));
+    std::filesystem::rename(tmp, file);
+    entry.bytes = std::filesystem::file_size(file);
+
+    std::vector<Entry> entries = read_index();
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.key == entry.key; }), entries.end());
+    entries.push_back(entry);
+    drop_expired(entries);
+
+    //evict oldest first, never the entry we just wrote
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time > b.time; });
+    size_t total = 0;
+    std::vector<Entry> kept;
+    for(Entry& e : entries) {
+        total += e.bytes;
+        if(total > max_bytes && e.key != entry.key) {
+            std::error_code ec;
+            std::filesystem::remove(path(e.key + ".json.gz"), ec);
+            total -= e.bytes;
+        }
+        else kept.push_back(e);
+    }
+    write_index(kept);
+    std::cout << "OVERPASS CACHE : stored " << entry.key << ", " << (entry.bytes >> 10) << " KB compressed" << std::endl;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "../defs.h"
+
+//on disk cache of overpass responses so repeated runs over the same area don't refetch. 
+//each response is stored gzip compressed under the hash of its query, and an index records 
+//the bounding box, fetch time and size of every entry. a lookup first tries the exact query, 
+//then the smallest cached box that contains the requested one, since a superset of the ways 
+//builds a graph that routes the requested area just as well. 
+//
+//entries older than the ttl are dropped on lookup, and the oldest entries are evicted once 
+//the total size goes over the budget. disabled when dir is empty, and always under wasm. 
+struct OverpassCache {
+    //settable from the command line
+    static std::string dir;
+    static ld ttl_hours;
+    static size_t max_bytes;
+
+    struct Entry {
+        std::string key;
+        ld min_lat, min_lon, max_lat, max_lon;
+        ll time;
+        ll bytes;
+
+        bool contains(ld _min_lat, ld _min_lon, ld _max_lat, ld _max_lon) const;
+
+        static Entry parse(json& j);
+        json to_json();
+    };
+
+    //fills body with a cached response covering the box, returns false on a miss. 
+    //both find and store log local disk errors and carry on as if there were no cache
+    static bool find(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body);
+
+    //stores the response to query, then evicts down to the budget
+    static void store(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body);
+
+    //64 bit FNV-1a of the query as hex
+    static std::string hash(const std::string& query);
+
+private:
+    static std::mutex mtx;
+
+    //find and store proper, throwing on disk errors
+    static bool find_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, std::string& body);
+    static void store_entry(const std::string& query, ld min_lat, ld min_lon, ld max_lat, ld max_lon, const std::string& body);
+
+    static std::string path(const std::string& name);
+    static std::vector<Entry> read_index();
+    static void write_index(std::vector<Entry>& entries);
+    static bool read_entry(const Entry& e, std::string& body);
+
+    //removes expired entries and entries whose file is gone, deleting their files
+    static void drop_expired(std::vector<Entry>& entries);
+};
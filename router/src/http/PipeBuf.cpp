@@ -0,0 +1,38 @@
+#include "PipeBuf.h"
+
+bool PipeBuf::write(const char* data, size_t len) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return aborted || queued < capacity; });
+    if(aborted) return false;
+    chunks.emplace_back(data, len);
+    queued += len;
+    cv.notify_all();
+    return true;
+}
+
+void PipeBuf::close() {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed = true;
+    cv.notify_all();
+}
+
+void PipeBuf::abort() {
+    std::lock_guard<std::mutex> lock(mtx);
+    aborted = true;
+    chunks.clear();
+    queued = 0;
+    cv.notify_all();
+}
+
+PipeBuf::int_type PipeBuf::underflow() {
+    if(gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return !chunks.empty() || closed || aborted; });
+    if(chunks.empty()) return traits_type::eof();
+    current = std::move(chunks.front());
+    chunks.pop_front();
+    queued -= current.size();
+    cv.notify_all();
+    setg(current.data(), current.data(), current.data() + current.size());
+    return traits_type::to_int_type(*gptr());
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <streambuf>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+//stream buffer connecting a writer thread to a reader thread, so a response can be parsed 
+//through a std::istream while it is still downloading. write() blocks while more than capacity 
+//bytes are queued, reads block until data arrives or the writer calls close(). 
+struct PipeBuf : std::streambuf {
+    PipeBuf(size_t _capacity = (size_t) 1 << 22) : capacity(_capacity) {}
+
+    //returns false once the reader has given up, in which case data is dropped
+    bool write(const char* data, size_t len);
+
+    //end of input for the reader
+    void close();
+
+    //called by the reader when it stops early so a blocked writer doesn't wait forever
+    void abort();
+
+protected:
+    int_type underflow() override;
+
+private:
+    size_t capacity, queued = 0;
+    bool closed = false, aborted = false;
+    std::deque<std::string> chunks;
+    std::string current;    //chunk the get area points into
+    std::mutex mtx;
+    std::condition_variable cv;
+};
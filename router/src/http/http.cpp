@@ -151,6 +151,24 @@ HttpResponse http_request(
     return resp;
 }
 
+// emscripten fetch only hands over the body once it is complete
+HttpResponse http_request_stream(
+    const std::string& url,
+    const std::function<bool(const char*, size_t)>& on_data,
+    const std::string& method,
+    const std::string& body,
+    const std::vector<std::string>& headers,
+    long timeout,
+    long connect_timeout,
+    bool follow_redirects,
+    const char* user_agent
+) {
+    HttpResponse resp = http_request(url, method, body, headers, timeout, connect_timeout, follow_redirects, user_agent);
+    on_data(resp.body.data(), resp.body.size());
+    resp.body.clear();
+    return resp;
+}
+
 std::string url_encode(const std::string& s) {
     std::string out; out.reserve(s.size()*3);
     auto is_unreserved = [](unsigned char c){
@@ -198,9 +216,9 @@ int main() {
 
 #else
 size_t write_body_cb(char* ptr, size_t size, size_t nmemb, void* userdata) {
-    auto* out = static_cast<std::string*>(userdata);
-    out->append(ptr, size * nmemb);
-    return size * nmemb;
+    auto* on_data = static_cast<const std::function<bool(const char*, size_t)>*>(userdata);
+    // anything other than the full size makes curl abort the transfer
+    return (*on_data)(ptr, size * nmemb) ? size * nmemb : 0;
 }
 size_t write_hdr_cb(char* ptr, size_t size, size_t nmemb, void* userdata) {
     auto* out = static_cast<std::vector<std::string>*>(userdata);
@@ -224,6 +242,27 @@ HttpResponse http_request(
     long connect_timeout,
     bool follow_redirects,
     const char* user_agent
+) {
+    std::string resp_body;
+    HttpResponse resp = http_request_stream(
+        url,
+        [&](const char* data, size_t len) { resp_body.append(data, len); return true; },
+        method, body, headers, timeout, connect_timeout, follow_redirects, user_agent
+    );
+    resp.body = std::move(resp_body);
+    return resp;
+}
+
+HttpResponse http_request_stream(
+    const std::string& url,
+    const std::function<bool(const char*, size_t)>& on_data,
+    const std::string& method,
+    const std::string& body,
+    const std::vector<std::string>& headers,
+    long timeout,
+    long connect_timeout,
+    bool follow_redirects,
+    const char* user_agent
 ) {
     CURLcode rc;
     HttpResponse resp;
@@ -262,7 +301,7 @@ HttpResponse http_request(
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdrs);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_body_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &resp.body);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &on_data);
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_hdr_cb);
     curl_easy_setopt(curl, CURLOPT_HEADERDATA, &resp.headers);
     curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
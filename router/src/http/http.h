@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <functional>
 
 struct HttpResponse {
     long status = 0;                     // HTTP status code
@@ -35,6 +36,20 @@ HttpResponse http_request(
     const char* user_agent = "cpp-libcurl/1.0"
 );
 
+// same as http_request, but the body is handed to on_data in chunks as it arrives 
+// instead of being collected in resp.body. returning false from on_data aborts the transfer
+HttpResponse http_request_stream(
+    const std::string& url,
+    const std::function<bool(const char*, size_t)>& on_data,
+    const std::string& method = "GET",
+    const std::string& body = "",
+    const std::vector<std::string>& headers = {},
+    long timeout = 60,
+    long connect_timeout = 10,
+    bool follow_redirects = true,
+    const char* user_agent = "cpp-libcurl/1.0"
+);
+
 std::string url_encode(const std::string& s);
 
 HttpResponse http_request_retry(
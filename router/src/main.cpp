@@ -18,16 +18,14 @@
 #include "utils.h"
 
 // returns a GeoJSON FeatureCollection with a single LineString feature.
-json nodes_to_geojson(std::vector<Node*>& nodes) {
-    assert(nodes.size() != 0);
+json coords_to_geojson(const std::vector<Coordinate>& path) {
+    assert(path.size() != 0);
 
     json coords = json::array();
-    for (const Node* n : nodes) {
-        assert(n != nullptr);
-
+    for (const Coordinate& c : path) {
         // GeoJSON expects [lon, lat]
-        double lon = (double) (n->coord->lon);
-        double lat = (double) (n->coord->lat);
+        double lon = (double) (c.lon);
+        double lat = (double) (c.lat);
         coords.push_back({lon, lat});
     }
 
@@ -59,12 +57,12 @@ void do_test() {
 
     // walkable
     bool walkable = true;
-    Coordinate *a = utils::geocode_freeform("11012 Deep Brook Drive, Austin TX");
-    Coordinate *b = utils::geocode_freeform("10316 Prism Drive, Austin TX");
+    Coordinate a = utils::geocode_freeform("11012 Deep Brook Drive, Austin TX");
+    Coordinate b = utils::geocode_freeform("10316 Prism Drive, Austin TX");
 
     std::cout << "PATHING TEST" << std::endl;
-    ld start_lat = a->lat, start_lon = a->lon;
-    ld end_lat = b->lat, end_lon = b->lon;
+    ld start_lat = a.lat, start_lon = a.lon;
+    ld end_lat = b.lat, end_lon = b.lon;
 
     ld min_lat = std::min(start_lat, end_lat);
     ld min_lon = std::min(start_lon, end_lon);
@@ -80,20 +78,18 @@ void do_test() {
     Graph* g = utils::create_graph(min_lat, min_lon, max_lat, max_lon);
     std::cout << "DONE CREATE GRAPH\n";
 
-    int start = g->get_node(new Coordinate(start_lat, start_lon), walkable);
-    int end = g->get_node(new Coordinate(end_lat, end_lon), walkable);
+    int start = g->get_node(Coordinate(start_lat, start_lon), walkable);
+    int end = g->get_node(Coordinate(end_lat, end_lon), walkable);
     std::vector<int> path = g->get_path(start, end, walkable);
     
+    std::vector<Coordinate> coords = g->get_path_coords(path, walkable);
+
     std::cout << "PATH : \n";
-    for(int x : path) {
-        Node* node = g->nodes[x];
-        std::cout << std::fixed << std::setprecision(10) << node->coord->lat << " " << node->coord->lon << "\n";
+    for(const Coordinate& c : coords) {
+        std::cout << std::fixed << std::setprecision(10) << c.lat << " " << c.lon << "\n";
     }
 
-    std::vector<Node*> nodes(path.size());
-    for(int i = 0; i < path.size(); i++) nodes[i] = g->nodes[path[i]];
-
-    json geojson = nodes_to_geojson(nodes);
+    json geojson = coords_to_geojson(coords);
     std::cout << geojson << "\n";
 }
 
@@ -118,6 +114,7 @@ BRP* parse_brp(char* json_str) {
     }
     catch(const std::runtime_error e) {
         std::cout << "BRP validation error : " << e.what() << "\n";
+        delete brp;
         return nullptr;
     }
     std::cout << "DONE VALIDATING INPUT" << std::endl;
@@ -150,6 +147,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p1(char* json_str, char** json_out) {
     }
     catch(const std::runtime_error e) {
         std::cout << "BRP validation error : " << e.what() << "\n";
+        delete brp;
         return kValidateErrorMsg;
     }
     std::cout << "DONE VALIDATING OUTPUT" << std::endl;
@@ -159,6 +157,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p1(char* json_str, char** json_out) {
     brp->do_eval();
 
     json output = brp->to_json();
+    delete brp;
     std::string output_str = to_string(output);
 
     //char* cstr = (char*) malloc(output_str.size());
@@ -184,6 +183,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p2(char* json_str, char** json_out) {
     }
     catch(const std::runtime_error e) {
         std::cout << "BRP validation error : " << e.what() << "\n";
+        delete brp;
         return kValidateErrorMsg;
     }
     std::cout << "DONE VALIDATING OUTPUT" << std::endl;
@@ -193,6 +193,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p2(char* json_str, char** json_out) {
     brp->do_eval();
 
     json output = brp->to_json();
+    delete brp;
     std::string output_str = to_string(output);
 
     //char* cstr = (char*) malloc(output_str.size());
@@ -219,6 +220,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p3(char* json_str, char** json_out) {
     }
     catch(const std::runtime_error e) {
         std::cout << "BRP validation error : " << e.what() << "\n";
+        delete brp;
         return kValidateErrorMsg;
     }
     std::cout << "DONE VALIDATING OUTPUT" << std::endl;
@@ -228,6 +230,7 @@ extern EMSCRIPTEN_KEEPALIVE char* do_p3(char* json_str, char** json_out) {
     brp->do_eval();
 
     json output = brp->to_json();
+    delete brp;
     std::string output_str = to_string(output);
 
     //char* cstr = (char*) malloc(output_str.size());
@@ -262,6 +265,21 @@ int main(int argc, char* argv[]) {
         std::cout << "<p1 | p2 | p3 | full> <in_file>\n";
         std::cout << "-o <out_file>\n";
         std::cout << "-geojson : returns a geojson representation of the resulting BRP\n";
+        std::cout << "-cache_mb <mb> : memory budget for cached shortest path rows. without -cache_rows the only rows are those warm started from the input graph\n";
+        std::cout << "-keep_chains : don't contract chains of degree 2 nodes in the road graph\n";
+        std::cout << "-keep_node_order : don't renumber road graph nodes along a hilbert curve\n";
+        std::cout << "-keep_fragments : don't prune road graph pieces cut off from the main walk and drive networks\n";
+        std::cout << "-radix_heap : use a radix heap instead of a binary heap in dijkstra\n";
+        std::cout << "-no_ch : answer driving queries by searching the road graph instead of a contraction hierarchy\n";
+        std::cout << "-cache_rows : answer distance and path queries from cached full shortest path rows, faster when the same sources meet many targets\n";
+        std::cout << "-landmarks <k> : landmarks per travel mode for astar and distance lower bounds, 0 to turn them off (default 16)\n";
+        std::cout << "-threads <n> : worker threads for batched shortest path searches, 0 for one per core (default)\n";
+        std::cout << "-read_graph <file> : load the road graph from a snapshot instead of fetching it\n";
+        std::cout << "-write_graph <file> : save the road graph as a snapshot after solving\n";
+        std::cout << "-osm_file <file> : build the road graph from a local .osm.pbf or .osm extract instead of overpass\n";
+        std::cout << "-overpass_cache <dir> : keep overpass responses in dir and reuse them across runs\n";
+        std::cout << "-overpass_cache_ttl <hours> : age after which cached responses are refetched, default 168\n";
+        std::cout << "-overpass_cache_mb <mb> : size limit of the overpass cache, default 1024\n";
         return 1;
     }
 
@@ -294,6 +312,7 @@ int main(int argc, char* argv[]) {
     bool to_geojson = false;
     int argptr = 3;
     std::string outfile = "";
+    std::string read_graph_file = "", write_graph_file = "";
     while(argptr != argc) {
         std::string next(argv[argptr ++]);
         if(next == "-geojson") {
@@ -306,6 +325,87 @@ int main(int argc, char* argv[]) {
             }
             outfile = std::string(argv[argptr ++]);
         }
+        else if(next == "-cache_mb") {
+            if(argptr == argc) {
+                std::cout << "Missing cache budget\n";
+                return 1;
+            }
+            PathCache::default_budget_bytes = (size_t) std::stoll(argv[argptr ++]) << 20;
+        }
+        else if(next == "-keep_chains") {
+            Graph::contract_chains_on_parse = false;
+        }
+        else if(next == "-keep_node_order") {
+            Graph::reorder_nodes_on_parse = false;
+        }
+        else if(next == "-keep_fragments") {
+            Graph::prune_fragments_on_parse = false;
+        }
+        else if(next == "-radix_heap") {
+            Graph::use_radix_heap = true;
+        }
+        else if(next == "-no_ch") {
+            Graph::use_ch = false;
+        }
+        else if(next == "-cache_rows") {
+            Graph::cache_rows = true;
+        }
+        else if(next == "-landmarks") {
+            if(argptr == argc) {
+                std::cout << "Missing landmark count\n";
+                return 1;
+            }
+            Graph::nr_landmarks = std::stoi(argv[argptr ++]);
+        }
+        else if(next == "-threads") {
+            if(argptr == argc) {
+                std::cout << "Missing thread count\n";
+                return 1;
+            }
+            ThreadPool::default_threads = std::stoi(argv[argptr ++]);
+        }
+        else if(next == "-read_graph") {
+            if(argptr == argc) {
+                std::cout << "Missing graph snapshot file\n";
+                return 1;
+            }
+            read_graph_file = std::string(argv[argptr ++]);
+        }
+        else if(next == "-write_graph") {
+            if(argptr == argc) {
+                std::cout << "Missing graph snapshot file\n";
+                return 1;
+            }
+            write_graph_file = std::string(argv[argptr ++]);
+        }
+        else if(next == "-osm_file") {
+            if(argptr == argc) {
+                std::cout << "Missing osm extract file\n";
+                return 1;
+            }
+            OSMImporter::extract_path = std::string(argv[argptr ++]);
+        }
+        else if(next == "-overpass_cache") {
+            if(argptr == argc) {
+                std::cout << "Missing overpass cache directory\n";
+                return 1;
+            }
+            OverpassCache::dir = std::string(argv[argptr ++]);
+        }
+        else if(next == "-overpass_cache_ttl") {
+            if(argptr == argc) {
+                std::cout << "Missing overpass cache ttl\n";
+                return 1;
+            }
+            OverpassCache::ttl_hours = std::stold(argv[argptr ++]);
+        }
+        else if(next == "-overpass_cache_mb") {
+            if(argptr == argc) {
+                std::cout << "Missing overpass cache size\n";
+                return 1;
+            }
+            OverpassCache::max_bytes = (size_t) std::stoll(argv[argptr ++]) << 20;
+        }
         else {
             std::cout << "Unknown flag : " + next << "\n";
             return 1;
@@ -333,6 +433,26 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "DONE VALIDATING INPUT" << std::endl;
 
+    //the snapshot replaces any graph given in the input and has to cover the input's bounding box
+    if(read_graph_file != "") {
+        try {
+            Graph* g = Graph::read_snapshot(read_graph_file);
+            ld min_lat, min_lon, max_lat, max_lon;
+            brp->bounding_box(min_lat, min_lon, max_lat, max_lon);
+            if(!g->covers(min_lat, min_lon, max_lat, max_lon)) {
+                delete g;
+                throw std::runtime_error("snapshot doesn't cover the bounding box of the input");
+            }
+            if(brp->graph.has_value()) delete brp->graph.value();
+            brp->graph = g;
+        }
+        catch(const std::runtime_error& e) {
+            std::cout << "Graph snapshot error : " << e.what() << "\n";
+            delete brp;
+            return 1;
+        }
+    }
+
     //solve BRP
     try {
         std::cout << "SOLVING BRP : " << type << std::endl;
@@ -374,6 +494,21 @@ int main(int argc, char* argv[]) {
 
     //do evals
     brp->do_eval();
+    {
+        PathCache& cache = brp->create_graph()->cache;
+        std::cout << "PATH CACHE : " << cache.hits << " hits, " << cache.misses << " misses, " << cache.evictions << " evictions, " << (cache.used_bytes >> 20) << " MB\n";
+    }
+
+    //written after solving so that any contraction hierarchy built along the way is saved too. 
+    //the snapshot is a side artifact, failing to write it doesn't cost the output
+    if(write_graph_file != "") {
+        try {
+            brp->create_graph()->write_snapshot(write_graph_file);
+        }
+        catch(const std::runtime_error& e) {
+            std::cout << "Graph snapshot error, continuing without it : " << e.what() << "\n";
+        }
+    }
     std::cout << "EVALS : \n";
     for(auto i = brp->evals.begin(); i != brp->evals.end(); i++) {
         std::cout << i->first << " : " << i->second << "\n";
@@ -11,18 +11,28 @@
 #include "../algorithm/mcmf.h"
 #include "../algorithm/dbscan.h"
 #include "../algorithm/dsu.h"
+#include "../graph/Dijkstra.h"
 
 namespace {
 
 void destroy_bus_stop_vector(std::vector<BusStop*>& stops) {
     for(BusStop* stop : stops) {
         if(!stop) continue;
-        delete stop->pos;
         delete stop;
     }
     stops.clear();
 }
 
+void destroy_assignment_vector(std::vector<BusStopAssignment*>& assignments) {
+    for(BusStopAssignment* assignment : assignments) delete assignment;
+    assignments.clear();
+}
+
+void destroy_route_vector(std::vector<BusRoute*>& routes) {
+    for(BusRoute* route : routes) delete route;
+    routes.clear();
+}
+
 std::unordered_map<sid_t, size_t> build_sid_index(const std::vector<Student*>& students) {
     std::unordered_map<sid_t, size_t> index;
     for(size_t i = 0; i < students.size(); ++i) {
@@ -31,8 +41,8 @@ std::unordered_map<sid_t, size_t> build_sid_index(const std::vector<Student*>& s
     return index;
 }
 
-int ensure_drive_node(Graph* graph, Coordinate* coord) {
-    if(!graph || !coord) return -1;
+int ensure_drive_node(Graph* graph, const Coordinate& coord) {
+    if(!graph) return -1;
     int node = graph->get_node(coord, false);
     if(node >= 0) return node;
     node = graph->get_node(coord, true);
@@ -68,13 +78,13 @@ struct DriveRouteData {
 bool build_drive_route_data(
     Graph* graph,
     const std::vector<BusStop*>& stops,
-    Coordinate* school,
+    const Coordinate& school,
     DriveRouteData& out
 ) {
     out.stop_to_stop.clear();
     out.school_to_stop.clear();
     out.stop_to_school.clear();
-    if(!graph || !school || stops.empty()) return false;
+    if(!graph || stops.empty()) return false;
 
     const double INF = std::numeric_limits<double>::infinity();
     const size_t n = stops.size();
@@ -89,34 +99,27 @@ bool build_drive_route_data(
     int school_node = ensure_drive_node(graph, school);
     if(school_node < 0) return false;
 
-    // Distances from school to stops
-    std::vector<ld> dist;
-    std::vector<int> prev;
-    graph->sssp(school_node, false, dist, prev);
+    // One many-to-many table over the valid stops plus the school (last row / column)
+    std::vector<int> nodes;
+    std::vector<size_t> node_stop;
     for(size_t i = 0; i < n; ++i) {
-        int node = stop_nodes[i];
-        if(node >= 0 && node < (int)dist.size()) {
-            out.school_to_stop[i] = dist[node];
-        }
+        if(stop_nodes[i] < 0) continue;
+        nodes.push_back(stop_nodes[i]);
+        node_stop.push_back(i);
     }
+    const size_t m = nodes.size();
+    nodes.push_back(school_node);
+    std::vector<ld> table = graph->distance_table(nodes, nodes, false);
+    auto at = [&](size_t i, size_t j) { return table[i * (m + 1) + j]; };
 
-    bool ok = false;
-    for(size_t i = 0; i < n; ++i) {
-        int node = stop_nodes[i];
-        if(node < 0) continue;
-        graph->sssp(node, false, dist, prev);
-        if(school_node >= 0 && school_node < (int)dist.size()) {
-            out.stop_to_school[i] = dist[school_node];
-        }
-        for(size_t j = 0; j < n; ++j) {
-            int other = stop_nodes[j];
-            if(other >= 0 && other < (int)dist.size()) {
-                out.stop_to_stop[i][j] = dist[other];
-                ok = true;
-            }
+    for(size_t a = 0; a < m; ++a) {
+        out.school_to_stop[node_stop[a]] = at(m, a);
+        out.stop_to_school[node_stop[a]] = at(a, m);
+        for(size_t b = 0; b < m; ++b) {
+            out.stop_to_stop[node_stop[a]][node_stop[b]] = at(a, b);
         }
     }
-    return ok;
+    return m > 0;
 }
 
 double estimate_single_bus_route(const DriveRouteData& data) {
@@ -181,24 +184,13 @@ void accumulate_stop_walk_metrics(
         if(node < 0) continue;
         remaining[node] += 1;
     }
-    struct State {
-        ld dist;
-        int node;
-    };
-    auto cmp = [](const State& a, const State& b){ return a.dist > b.dist; };
-    std::priority_queue<State, std::vector<State>, decltype(cmp)> pq(cmp);
-    std::vector<ld> dist(node_count, INF);
-    dist[walk_node] = 0;
-    pq.push({0, walk_node});
+    thread_local SearchScratch sc;
+    sc.reset(node_count);
     double local_max = 0.0;
-    while(!pq.empty()) {
-        State cur = pq.top();
-        pq.pop();
-        if(cur.dist > dist[cur.node]) continue;
-        if(cur.dist > INF) break;
-        auto it = remaining.find(cur.node);
+    dijkstra<BinaryHeap>(graph->walk_csr, walk_node, INF, sc.d, sc.touched, nullptr, [&](int node, ld dist) {
+        auto it = remaining.find(node);
         if(it != remaining.end()) {
-            double cur_dist = static_cast<double>(cur.dist);
+            double cur_dist = static_cast<double>(dist);
             for(int cnt = 0; cnt < it->second; ++cnt) {
                 total += cur_dist;
                 local_max = std::max(local_max, cur_dist);
@@ -209,18 +201,9 @@ void accumulate_stop_walk_metrics(
                 ++served;
             }
             remaining.erase(it);
-            if(remaining.empty()) break;
-        }
-        for(Edge* edge : graph->adj[cur.node]) {
-            if(!edge->is_walkable) continue;
-            int next = static_cast<int>(edge->v);
-            if(next < 0 || next >= static_cast<int>(node_count)) continue;
-            ld ndist = cur.dist + edge->dist;
-            if(ndist >= dist[next] || ndist > INF) continue;
-            dist[next] = ndist;
-            pq.push({ndist, next});
         }
-    }
+        return remaining.empty();
+    });
     if(!remaining.empty()) {
         double capped = static_cast<double>(INF);
         for(const auto& entry : remaining) {
@@ -289,7 +272,7 @@ WalkStats compute_walk_stats(
 
 double score_phase1_solution(
     Graph* graph,
-    Coordinate* school,
+    const Coordinate& school,
     const std::vector<Student*>& students,
     std::vector<BusStop*>& stops,
     const std::unordered_map<sid_t, size_t>& sid_index,
@@ -306,12 +289,12 @@ double score_phase1_solution(
         return std::numeric_limits<double>::infinity();
     }
     double walk_score = stats->score;
-    if(!graph || !school) {
+    if(!graph) {
         return walk_score;
     }
     DriveRouteData drive_data;
     double route_score = std::numeric_limits<double>::infinity();
-    if(school && build_drive_route_data(graph, stops, school, drive_data)) {
+    if(build_drive_route_data(graph, stops, school, drive_data)) {
         route_score = estimate_single_bus_route(drive_data);
     }
     if(!std::isfinite(route_score)) {
@@ -336,10 +319,10 @@ static void merge_dense_stops(Graph* graph, std::vector<BusStop*>& stops, double
                 BusStop* rhs = stops[j];
                 int node_j = ensure_stop_node(graph, rhs, false);
                 if(node_j < 0) continue;
+                if(graph->lower_bound(node_i, node_j, false) > limit) continue;
                 ld d = graph->get_dist(node_i, node_j, false);
                 if(!std::isfinite(d) || d > limit) continue;
                 lhs->students.insert(lhs->students.end(), rhs->students.begin(), rhs->students.end());
-                delete rhs->pos;
                 delete rhs;
                 stops.erase(stops.begin() + j);
                 merged = true;
@@ -350,8 +333,8 @@ static void merge_dense_stops(Graph* graph, std::vector<BusStop*>& stops, double
 }
 
 BRP::BRP(
-    Coordinate* _school, 
-    Coordinate* _bus_yard, 
+    Coordinate _school, 
+    Coordinate _bus_yard, 
     std::vector<Student*> _students, 
     std::vector<Bus*> _buses, 
     std::optional<std::vector<BusStop*>> _stops,
@@ -361,21 +344,30 @@ BRP::BRP(
 ) {
     school = _school;
     bus_yard = _bus_yard;
-    students = _students;
-    buses = _buses;
-    stops = _stops;
-    assignments = _assignments;
-    routes = _routes;
+    students = std::move(_students);
+    buses = std::move(_buses);
+    stops = std::move(_stops);
+    assignments = std::move(_assignments);
+    routes = std::move(_routes);
     graph = _graph;
 }
 
+BRP::~BRP() {
+    for(Student* s : students) delete s;
+    for(Bus* b : buses) delete b;
+    if(stops.has_value()) destroy_bus_stop_vector(stops.value());
+    if(assignments.has_value()) destroy_assignment_vector(assignments.value());
+    if(routes.has_value()) destroy_route_vector(routes.value());
+    if(graph.has_value()) delete graph.value();
+}
+
 BRP* BRP::parse(json& j) {
     if(!j.contains("school")) throw std::runtime_error("BRP missing school");
     if(!j.contains("bus_yard")) throw std::runtime_error("BRP missing bus_yard");
     if(!j.contains("students")) throw std::runtime_error("BRP missing students");
     if(!j.contains("buses")) throw std::runtime_error("BRP missing buses");
-    Coordinate *school = Coordinate::parse(j["school"]);
-    Coordinate *bus_yard = Coordinate::parse(j["bus_yard"]);
+    Coordinate school = Coordinate::parse(j["school"]);
+    Coordinate bus_yard = Coordinate::parse(j["bus_yard"]);
     std::vector<Student*> students;
     for(int i = 0; i < j["students"].size(); i++) {
         students.push_back(Student::parse(j["students"][i]));
@@ -431,8 +423,8 @@ BRP* BRP::parse(json& j) {
 
 json BRP::to_json() {
     json ret;
-    ret["school"] = this->school->to_json();
-    ret["bus_yard"] = this->bus_yard->to_json();
+    ret["school"] = this->school.to_json();
+    ret["bus_yard"] = this->bus_yard.to_json();
     std::vector<json> students_json;
     for(int i = 0; i < this->students.size(); i++) {
         students_json.push_back(this->students[i]->to_json());
@@ -478,8 +470,6 @@ json BRP::to_json() {
 }
 
 BRP* BRP::make_copy() {
-    Coordinate *_school = school->make_copy();
-    Coordinate *_bus_yard = bus_yard->make_copy();
     std::vector<Student*> _students;
     for(int i = 0; i < students.size(); i++) _students.push_back(students[i]->make_copy());
     std::vector<Bus*> _buses;
@@ -505,8 +495,8 @@ BRP* BRP::make_copy() {
     }
 
     return new BRP( 
-        _school,
-        _bus_yard,
+        school,
+        bus_yard,
         _students,
         _buses,
         _stops,
@@ -542,7 +532,7 @@ json BRP::to_geojson() {
             }},
             {"geometry", {
                 {"type", "Point"},
-                {"coordinates", {this->school->lon, this->school->lat}}
+                {"coordinates", {this->school.lon, this->school.lat}}
             }}
         };
         features.push_back(feature);
@@ -561,7 +551,7 @@ json BRP::to_geojson() {
     if (this->stops.has_value() && !this->assignments.has_value()) {
         for (size_t i = 0; i < this->stops.value().size(); ++i) {
             BusStop *stop = this->stops.value()[i];
-            Coordinate *stop_pos = stop->pos;
+            const Coordinate& stop_pos = stop->pos;
             const char* color = PAL[i % PAL_N];
 
             json stop_feature = {
@@ -573,14 +563,14 @@ json BRP::to_geojson() {
                 }},
                 {"geometry", {
                     {"type", "Point"},
-                    {"coordinates", {stop_pos->lon, stop_pos->lat}}
+                    {"coordinates", {stop_pos.lon, stop_pos.lat}}
                 }}
             };
             features.push_back(stop_feature);
 
             for (sid_t sid : stop->students) {
                 Student* stu = this->get_student(sid);
-                Coordinate *stu_pos = stu->pos;
+                const Coordinate& stu_pos = stu->pos;
 
                 json stu_feature = {
                     {"type", "Feature"},
@@ -591,7 +581,7 @@ json BRP::to_geojson() {
                     }},
                     {"geometry", {
                         {"type", "Point"},
-                        {"coordinates", {stu_pos->lon, stu_pos->lat}}
+                        {"coordinates", {stu_pos.lon, stu_pos.lat}}
                     }}
                 };
                 features.push_back(stu_feature);
@@ -609,7 +599,7 @@ json BRP::to_geojson() {
 
             for(auto j : assignment->stops) {
                 BusStop *stop = this->get_stop(j);
-                Coordinate * pos = stop->pos;
+                const Coordinate& pos = stop->pos;
                 json feature = {
                     {"type", "Feature"},
                     {"properties", {
@@ -619,7 +609,7 @@ json BRP::to_geojson() {
                     }},
                     {"geometry", {
                         {"type", "Point"},
-                        {"coordinates", {pos->lon, pos->lat}}
+                        {"coordinates", {pos.lon, pos.lat}}
                     }}
                 };
                 features.push_back(feature);
@@ -637,7 +627,7 @@ json BRP::to_geojson() {
 
             for(int j = 0; j < route->paths.size(); j++) {
                 for(int k = 0; k < route->paths[j].size(); k++) {
-                    coords.push_back({route->paths[j][k]->lon, route->paths[j][k]->lat});
+                    coords.push_back({route->paths[j][k].lon, route->paths[j][k].lat});
                 }
             }
 
@@ -906,26 +896,24 @@ void BRP::validate() {
     }
 }
 
-Graph* BRP::create_graph() {
-    if(this->graph.has_value()) return this->graph.value();
-
-    ld min_lat = std::min(school->lat, bus_yard->lat), max_lat = std::max(school->lat, bus_yard->lat);
-    ld min_lon = std::min(school->lon, bus_yard->lon), max_lon = std::max(school->lon, bus_yard->lon);
+void BRP::bounding_box(ld& min_lat, ld& min_lon, ld& max_lat, ld& max_lon) {
+    min_lat = std::min(school.lat, bus_yard.lat), max_lat = std::max(school.lat, bus_yard.lat);
+    min_lon = std::min(school.lon, bus_yard.lon), max_lon = std::max(school.lon, bus_yard.lon);
     
     for(Student* s : this->students) {
-        min_lat = std::min(min_lat, s->pos->lat);
-        max_lat = std::max(max_lat, s->pos->lat);
-        min_lon = std::min(min_lon, s->pos->lon);
-        max_lon = std::max(max_lon, s->pos->lon);
+        min_lat = std::min(min_lat, s->pos.lat);
+        max_lat = std::max(max_lat, s->pos.lat);
+        min_lon = std::min(min_lon, s->pos.lon);
+        max_lon = std::max(max_lon, s->pos.lon);
     }
     // Include any existing stops so the bounding box always covers edited/added stops.
     if(this->stops.has_value()) {
         for(BusStop* stop : this->stops.value()) {
-            if(!stop || !stop->pos) continue;
-            min_lat = std::min(min_lat, stop->pos->lat);
-            max_lat = std::max(max_lat, stop->pos->lat);
-            min_lon = std::min(min_lon, stop->pos->lon);
-            max_lon = std::max(max_lon, stop->pos->lon);
+            if(!stop) continue;
+            min_lat = std::min(min_lat, stop->pos.lat);
+            max_lat = std::max(max_lat, stop->pos.lat);
+            min_lon = std::min(min_lon, stop->pos.lon);
+            max_lon = std::max(max_lon, stop->pos.lon);
         }
     }
 
@@ -941,7 +929,13 @@ Graph* BRP::create_graph() {
     min_lon -= buf;
     max_lat += buf;
     max_lon += buf;
+}
 
+Graph* BRP::create_graph() {
+    if(this->graph.has_value()) return this->graph.value();
+
+    ld min_lat, min_lon, max_lat, max_lon;
+    bounding_box(min_lat, min_lon, max_lat, max_lon);
     this->graph = utils::create_graph(min_lat, min_lon, max_lat, max_lon);
     return this->graph.value();
 }
@@ -951,7 +945,7 @@ void BRP::do_p1() {
     this->stops = std::vector<BusStop*>();
     for(int i = 0; i < this->students.size(); i++) {
         Student *s = this->students[i];
-        this->stops.value().push_back(new BusStop(i, s->pos->make_copy(), {s->id}));
+        this->stops.value().push_back(new BusStop(i, s->pos, {s->id}));
     }
 }
 */
@@ -1194,10 +1188,13 @@ void BRP::do_p2() {
         std::cout << "ITERATION : " << _ << std::endl;
 
         //compute assignment costs
+        //one table query. driving distances come from the contraction hierarchy's many to many buckets, 
+        //or with use_ch off from one search per centre over the reversed graph when there are fewer centres than stops
+        std::vector<ld> table = graph->distance_table(stop_graph_nodes, cluster_centers, false);
         std::vector<std::vector<ld>> cost(N, std::vector<ld>(M));
         for(int i = 0; i < N; i++) {
             for(int j = 0; j < M; j++) {
-                cost[i][j] = graph->get_dist(stop_graph_nodes[i], cluster_centers[j], false);
+                cost[i][j] = table[(size_t) i * M + j];
             }
         }
         std::cout << "COMPUTED COSTS : " << N << " " << M << " " << N * M << std::endl;
@@ -1214,9 +1211,9 @@ void BRP::do_p2() {
         std::vector<std::pair<ld, ld>> sum(M, {0, 0});
         std::vector<ld> amt(M, 0);
         for(int i = 0; i < N; i++) {
-            Coordinate* pos = this->stops.value()[i]->pos;
-            sum[assignment[i]].first += pos->lat;
-            sum[assignment[i]].second += pos->lon;
+            const Coordinate& pos = this->stops.value()[i]->pos;
+            sum[assignment[i]].first += pos.lat;
+            sum[assignment[i]].second += pos.lon;
             amt[assignment[i]] ++;
         }
         for(int i = 0; i < M; i++) {
@@ -1229,8 +1226,7 @@ void BRP::do_p2() {
             else {
                 sum[i].first /= amt[i];
                 sum[i].second /= amt[i];
-                Coordinate* npos = new Coordinate(sum[i].first, sum[i].second);
-                int graph_ind = graph->get_node(npos, false);
+                int graph_ind = graph->get_node(Coordinate(sum[i].first, sum[i].second), false);
                 cluster_centers[i] = graph_ind;
             }
         }
@@ -1246,6 +1242,9 @@ void BRP::do_p2() {
         assignments[assignment[i]]->stops.insert(this->stops.value()[i]->id);
     }
 
+    if(this->assignments.has_value()) {
+        destroy_assignment_vector(this->assignments.value());
+    }
     this->assignments = assignments;
 }
 
@@ -1377,7 +1376,6 @@ void BRP::do_p3() {
     assert(n > 0);
     std::map<bsid_t, int> indmp;
     std::vector<bsid_t> rindmp(n);
-    std::vector<Coordinate*> pos(n);
     for(int i = 0; i < this->stops.value().size(); i++) {
         BusStop *stop = this->stops.value()[i];
         bsid_t id = stop->id;
@@ -1385,7 +1383,6 @@ void BRP::do_p3() {
 
         indmp[id] = i;
         rindmp[i] = id;
-        pos[i] = stop->pos->make_copy();
     }
 
     auto stop_index_by_id = [&](bsid_t id)->int {
@@ -1416,13 +1413,6 @@ void BRP::do_p3() {
         }
     }
 
-    //get pairwise distances between all stops
-    std::vector<std::vector<ld>> dist(n);
-    std::vector<std::vector<int>> prev(n);
-    for(int i = 0; i < n; i++) {
-        graph->sssp(graph_ind[i], false, dist[i], prev[i]);
-    }
-
     //get distances from school to all stops and bus yard to all stops
     int school_graph_ind = ensure_drive_node(graph, this->school);
     int bus_yard_graph_ind = ensure_drive_node(graph, this->bus_yard);
@@ -1450,27 +1440,47 @@ void BRP::do_p3() {
         }
     };
 
-    auto require_prev = [&](const std::vector<int>& arr, int node, const std::string& ctx) -> int {
-        safe_idx(node, arr.size(), ctx);
-        int next = arr[node];
-        if(next < 0) {
+    //road geometry of a single leg, only computed for legs of the final routes
+    auto make_leg = [&](int from, int to, const std::string& ctx) {
+        std::vector<int> nodes;
+        try {
+            nodes = graph->get_path(from, to, false);
+        }
+        catch(const std::runtime_error& e) {
             throw std::runtime_error("BRP::do_p3() : disconnected path via " + ctx);
         }
-        return next;
+        for(int node : nodes) ensure_node_bounds(node, ctx);
+        return graph->get_path_coords(nodes, false);
     };
 
-    auto append_coord = [&](std::vector<Coordinate*>& pathVec, int node, const std::string& ctx){
-        ensure_node_bounds(node, ctx);
-        pathVec.push_back(graph->nodes[node]->coord->make_copy());
+    //get pairwise distances between all stops, from the bus yard to all stops, and from all stops to the school. 
+    //rows are stops then the bus yard, columns are stops then the school
+    std::vector<int> row_nodes = graph_ind, col_nodes = graph_ind;
+    row_nodes.push_back(bus_yard_graph_ind);
+    col_nodes.push_back(school_graph_ind);
+    std::vector<ld> table = graph->distance_table(row_nodes, col_nodes, false);
+    auto table_at = [&](int row, int col) -> ld {
+        safe_idx(row, n + 1, "table row");
+        safe_idx(col, n + 1, "table col");
+        return table[(size_t) row * (n + 1) + col];
     };
 
-    std::vector<ld> school_dist, bus_yard_dist;
-    std::vector<int> school_prev, bus_yard_prev;
-    graph->sssp(school_graph_ind, false, school_dist, school_prev);
-    graph->sssp(bus_yard_graph_ind, false, bus_yard_dist, bus_yard_prev);
+    //stops, the school and the bus yard all snap into the main drive component, so a gap here means 
+    //the graph itself is broken. better to stop now than halfway through building routes
+    for(int row = 0; row <= n; row++) {
+        for(int col = 0; col <= n; col++) {
+            if(table_at(row, col) != DIST_INF) continue;
+            std::string from = row == n ? "bus yard" : "stop " + std::to_string(this->stops.value()[row]->id);
+            std::string to = col == n ? "school" : "stop " + std::to_string(this->stops.value()[col]->id);
+            throw std::runtime_error("BRP::do_p3() : no drive path from " + from + " to " + to);
+        }
+    }
 
     //for each assignment, solve TSP
     std::srand(std::time(0));
+    if(this->routes.has_value()) {
+        destroy_route_vector(this->routes.value());
+    }
     this->routes = std::vector<BusRoute*>();
     for(int i = 0; i < this->assignments.value().size(); i++) {
         BusStopAssignment *assignment = this->assignments.value()[i];
@@ -1512,18 +1522,10 @@ void BRP::do_p3() {
         auto get_graph_node = [&](int stopIdx)->int {
             safe_idx(stopIdx, graph_ind.size(), "graph_ind");
             int node = graph_ind[stopIdx];
-            // bus_yard_dist and school_dist share graph sizing
-            safe_idx(node, bus_yard_dist.size(), "graph nodes");
             ensure_node_bounds(node, "graph node lookup");
             return node;
         };
 
-        auto get_dist_val = [&](int stopIdx, int nodeIdx)->ld {
-            safe_idx(stopIdx, dist.size(), "dist outer");
-            safe_idx(nodeIdx, dist[stopIdx].size(), "dist inner");
-            return dist[stopIdx][nodeIdx];
-        };
-
         //initialize with some random permutations 
         std::vector<std::vector<int>> population(POPULATION_MAX);
         for(int j = 0; j < POPULATION_MAX; j++) {
@@ -1552,16 +1554,14 @@ void BRP::do_p3() {
                 assert(cur.size() >= 1);
                 ld cdist = 0;
                 int firstStopIdx = get_stop_idx(cur[0]);
-                int firstNode = get_graph_node(firstStopIdx);
-                cdist += bus_yard_dist[firstNode];
+                cdist += table_at(n, firstStopIdx);
                 for(int k = 0; k < cur.size() - 1; k++) {
                     int uStop = get_stop_idx(cur[k]);
                     int vStop = get_stop_idx(cur[k + 1]);
-                    int vNode = get_graph_node(vStop);
-                    cdist += get_dist_val(uStop, vNode);
+                    cdist += table_at(uStop, vStop);
                 }
                 int lastStop = get_stop_idx(cur[cur.size() - 1]);
-                cdist += get_dist_val(lastStop, school_graph_ind);
+                cdist += table_at(lastStop, n);
                 ord[j] = {cdist, j};
             }
             sort(ord.begin(), ord.end());
@@ -1616,59 +1616,29 @@ void BRP::do_p3() {
             route_stops[j] = rindmp[stop_index];
         }
 
-        std::vector<std::vector<Coordinate*>> paths(m + 1);
+        std::vector<std::vector<Coordinate>> paths(m + 1);
         
         //bus yard to first stop
         {
-            std::vector<Coordinate*> path;
             int first_stop_idx = stop_index_by_id(route_stops[0]);
-            int ptr = get_graph_node(first_stop_idx);
-            while(ptr != bus_yard_graph_ind) {
-                append_coord(path, ptr, "bus_yard path");
-                ptr = require_prev(bus_yard_prev, ptr, "bus_yard_prev");
-            }
-            append_coord(path, bus_yard_graph_ind, "bus_yard path");
-            reverse(path.begin(), path.end());
-            paths[0] = path;
+            paths[0] = make_leg(bus_yard_graph_ind, get_graph_node(first_stop_idx), "bus_yard path");
         }   
 
         //between stops
         for(int i = 0; i < m - 1; i++) {
-            std::vector<Coordinate*> path;
             int stop_ind = stop_index_by_id(route_stops[i]);
-            int stop_graph_ind = get_graph_node(stop_ind);
             int next_stop_ind = stop_index_by_id(route_stops[i + 1]);
-            int ptr = get_graph_node(next_stop_ind);
-            safe_idx(stop_ind, prev.size(), "prev outer");
-            auto& stop_prev = prev[stop_ind];
-            while(ptr != stop_graph_ind) {
-                append_coord(path, ptr, "stop path");
-                ptr = require_prev(stop_prev, ptr, "stop prev");
-            }
-            append_coord(path, stop_graph_ind, "stop path");
-            reverse(path.begin(), path.end());
-            paths[i + 1] = path;
+            paths[i + 1] = make_leg(get_graph_node(stop_ind), get_graph_node(next_stop_ind), "stop path");
         }
 
         //last stop to school
         {
-            std::vector<Coordinate*> path;
             int stop_ind = stop_index_by_id(route_stops[m - 1]);
-            int stop_graph_ind = get_graph_node(stop_ind);
-            int ptr = school_graph_ind;
-            safe_idx(stop_ind, prev.size(), "prev outer");
-            auto& stop_prev = prev[stop_ind];
-            while(ptr != stop_graph_ind) {
-                append_coord(path, ptr, "school path");
-                ptr = require_prev(stop_prev, ptr, "school prev");
-            }
-            append_coord(path, stop_graph_ind, "school path");
-            reverse(path.begin(), path.end());
-            paths[m] = path;
+            paths[m] = make_leg(get_graph_node(stop_ind), school_graph_ind, "school path");
         }
 
         ld travel_time_min = best_dist / (1000.0 * 50.0 / 60.0);    //assume 50 km / h for now
-        this->routes.value().push_back(new BusRoute(i, assignment->id, route_stops, paths, travel_time_min));
+        this->routes.value().push_back(new BusRoute(i, assignment->id, std::move(route_stops), std::move(paths), travel_time_min));
     }
     
     assert(this->assignments.value().size() == this->routes.value().size());
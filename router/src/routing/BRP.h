@@ -14,8 +14,8 @@
 
 //bus routing problem
 struct BRP {
-    Coordinate* school;
-    Coordinate* bus_yard;
+    Coordinate school;
+    Coordinate bus_yard;
     std::vector<Student*> students;
     std::vector<Bus*> buses;
 
@@ -35,8 +35,8 @@ struct BRP {
     std::map<std::string, ld> evals;
 
     BRP(
-        Coordinate* school, 
-        Coordinate* bus_yard, 
+        Coordinate school, 
+        Coordinate bus_yard, 
         std::vector<Student*> students, 
         std::vector<Bus*> buses, 
         std::optional<std::vector<BusStop*>> stops,
@@ -45,6 +45,9 @@ struct BRP {
         std::optional<Graph*> graph
     );
 
+    //frees everything above, including the graph
+    ~BRP();
+
     static BRP* parse(json& j);
     BRP* make_copy();
     json to_json();
@@ -62,8 +65,10 @@ struct BRP {
     //ensures all semantic constraints are met
     void validate();
 
-    //generates lat/lon bounding box from school, bus_yard, and all students
-    //retrieves road graph within the bounding box. 
+    //lat/lon bounding box of school, bus_yard, all students and stops, plus a 2 mile buffer
+    void bounding_box(ld& min_lat, ld& min_lon, ld& max_lat, ld& max_lon);
+
+    //retrieves road graph within bounding_box
     Graph* create_graph();
 
     void do_p1();
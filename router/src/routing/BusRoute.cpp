@@ -1,10 +1,10 @@
 #include "BusRoute.h"
 
-BusRoute::BusRoute(brid_t _id, bsaid_t _assignment, std::vector<bsid_t> _stops, std::vector<std::vector<Coordinate*>> _paths, ld _travel_time_min) {
+BusRoute::BusRoute(brid_t _id, bsaid_t _assignment, std::vector<bsid_t> _stops, std::vector<std::vector<Coordinate>> _paths, ld _travel_time_min) {
     id = _id;
     assignment = _assignment;
-    stops = _stops;
-    paths = _paths;
+    stops = std::move(_stops);
+    paths = std::move(_paths);
     travel_time_min = _travel_time_min;
 }
 
@@ -19,16 +19,17 @@ BusRoute* BusRoute::parse(json& j) {
     bsaid_t assignment = j["assignment"];
     std::vector<bsid_t> stops = j["stops"];
     if(!j["paths"].is_array()) throw std::runtime_error("BusRoute paths malformed (not an array)");
-    std::vector<std::vector<Coordinate*>> paths;
+    std::vector<std::vector<Coordinate>> paths(j["paths"].size());
     for(int i = 0; i < j["paths"].size(); i++) {
         if(!j["paths"][i].is_array()) throw std::runtime_error("BusRoute paths[" + std::to_string(i) + "] malformed (not an array)");
-        std::vector<Coordinate*> path(j["paths"][i].size());
+        std::vector<Coordinate>& path = paths[i];
+        path.resize(j["paths"][i].size());
         for(int ii = 0; ii < path.size(); ii++) {
             path[ii] = Coordinate::parse(j["paths"][i][ii]);
         }
     }
     ld travel_time = j["travel_time"];
-    return new BusRoute(id, assignment, stops, paths, travel_time);
+    return new BusRoute(id, assignment, std::move(stops), std::move(paths), travel_time);
 }
 
 json BusRoute::to_json() {
@@ -40,7 +41,7 @@ json BusRoute::to_json() {
     for(int i = 0; i < this->paths.size(); i++) {
         std::vector<json> path;
         for(int j = 0; j < this->paths[i].size(); j++) {
-            path.push_back(this->paths[i][j]->to_json());
+            path.push_back(this->paths[i][j].to_json());
         }
         paths_json.push_back(path);
     }
@@ -50,13 +51,5 @@ json BusRoute::to_json() {
 }
 
 BusRoute* BusRoute::make_copy() {
-    std::vector<std::vector<Coordinate*>> _paths(this->paths.size());
-    for(int i = 0; i < this->paths.size(); i++) {
-        std::vector<Coordinate*> _path(this->paths[i].size());
-        for(int j = 0; j < _path.size(); j++) {
-            _path[j] = this->paths[i][j]->make_copy();
-        }
-        _paths[i] = _path;
-    }
-    return new BusRoute(id, assignment, stops, _paths, travel_time_min);
+    return new BusRoute(id, assignment, stops, paths, travel_time_min);
 }
\ No newline at end of file
@@ -11,9 +11,9 @@ struct BusRoute {
     brid_t id;
     bsaid_t assignment;
     std::vector<bsid_t> stops;
-    std::vector<std::vector<Coordinate*>> paths;
+    std::vector<std::vector<Coordinate>> paths;
     ld travel_time_min;
-    BusRoute(brid_t _id, bsaid_t _assignment, std::vector<bsid_t> _stops, std::vector<std::vector<Coordinate*>> _paths, ld _travel_time_min);
+    BusRoute(brid_t _id, bsaid_t _assignment, std::vector<bsid_t> _stops, std::vector<std::vector<Coordinate>> _paths, ld _travel_time_min);
 
     static BusRoute* parse(json& j);
     json to_json();
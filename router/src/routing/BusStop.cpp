@@ -1,9 +1,9 @@
 #include "BusStop.h"
 
-BusStop::BusStop(bsid_t _id, Coordinate* _pos, std::vector<sid_t> _students) {
+BusStop::BusStop(bsid_t _id, Coordinate _pos, std::vector<sid_t> _students) {
     id = _id;
     pos = _pos;
-    students = _students;
+    students = std::move(_students);
     walk_node = -1;
     drive_node = -1;
 }
@@ -14,19 +14,19 @@ BusStop* BusStop::parse(json& j) {
     if(!j.contains("students")) throw std::runtime_error("BusStop missing students");
     if(!j["students"].is_array()) throw std::runtime_error("BusStop students malformed");
     bsid_t id = j["id"];
-    Coordinate* pos = Coordinate::parse(j["pos"]);
+    Coordinate pos = Coordinate::parse(j["pos"]);
     std::vector<sid_t> students = j["students"];
-    return new BusStop(id, pos, students);
+    return new BusStop(id, pos, std::move(students));
 }
 
 json BusStop::to_json() {
     json ret;
     ret["id"] = this->id;
-    ret["pos"] = this->pos->to_json();
+    ret["pos"] = this->pos.to_json();
     ret["students"] = this->students;
     return ret;
 }
 
 BusStop* BusStop::make_copy() {
-    return new BusStop(id, pos->make_copy(), students);
+    return new BusStop(id, pos, students);
 }
@@ -6,12 +6,12 @@ typedef size_t bsid_t;
 
 struct BusStop {
     bsid_t id;
-    Coordinate* pos;
+    Coordinate pos;
     std::vector<sid_t> students;
     int walk_node = -1;
     int drive_node = -1;
 
-    BusStop(bsid_t _id, Coordinate* _pos, std::vector<sid_t> _students);
+    BusStop(bsid_t _id, Coordinate _pos, std::vector<sid_t> _students);
 
     static BusStop* parse(json& j);
     json to_json();
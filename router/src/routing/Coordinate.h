@@ -1,11 +1,12 @@
 #pragma once
 #include "../defs.h"
 
+//plain value, copied and stored inline rather than through pointers
 struct Coordinate {
     ld lat, lon;
+    Coordinate() : lat(0), lon(0) {}
     Coordinate(ld _lat, ld _lon);
 
-    static Coordinate* parse(json& j);
-    json to_json();
-    Coordinate* make_copy();
+    static Coordinate parse(json& j);
+    json to_json() const;
 };
\ No newline at end of file
@@ -4,11 +4,11 @@ typedef size_t sid_t;
 
 struct Student {
     sid_t id;
-    Coordinate* pos;
+    Coordinate pos;
     int walk_node = -1;
     int drive_node = -1;
 
-    Student(sid_t _id, Coordinate* _pos);
+    Student(sid_t _id, Coordinate _pos);
     
     static Student* parse(json& j);
     json to_json();
@@ -1,18 +1,18 @@
 #include "utils.h"
 
 namespace utils {
-    std::string run_overpass_fetch(const std::string& query){
-        std::string endpoint = "https://overpass-api.de/api/interpreter";
-        std::vector<std::string> headers = {
-            "Content-Type: text/plain",
-            "Accept: application/json"
-        };
+    const std::string overpass_endpoint = "https://overpass-api.de/api/interpreter";
+    const std::vector<std::string> overpass_headers = {
+        "Content-Type: text/plain",
+        "Accept: application/json"
+    };
 
+    std::string run_overpass_fetch(const std::string& query){
         const auto resp = http_request_retry(
-            endpoint,
+            overpass_endpoint,
             "POST",
             query,
-            headers,
+            overpass_headers,
             60,
             10,
             true,
@@ -28,6 +28,65 @@ namespace utils {
         return resp.body;
     }
 
+    Graph* run_overpass_stream(const std::string& query, bool keep_raw, std::string& raw, std::string& remark) {
+#if _ISWASM
+        //no threads to overlap with
+        return nullptr;
+#else
+        PipeBuf pipe;
+        HttpResponse resp;
+        std::string error;
+
+        //download on a separate thread, parsing here as the chunks come in
+        std::thread fetch([&] {
+            try {
+                resp = http_request_stream(
+                    overpass_endpoint,
+                    [&](const char* data, size_t len) {
+                        if(keep_raw) raw.append(data, len);
+                        return pipe.write(data, len);
+                    },
+                    "POST",
+                    query,
+                    overpass_headers,
+                    60,
+                    10,
+                    true,
+                    "overpass-client/1.0"
+                );
+            }
+            catch(const std::exception& e) {
+                error = e.what();
+            }
+            pipe.close();
+        });
+
+        Graph* g = nullptr;
+        std::string parse_error;
+        try {
+            std::istream in(&pipe);
+            g = Graph::parse_osm(in, &remark);
+        }
+        catch(const std::exception& e) {
+            parse_error = e.what();
+            pipe.abort();
+        }
+        fetch.join();
+
+        if(error == "" && (resp.status < 200 || resp.status >= 300)) error = "Overpass HTTP " + std::to_string(resp.status);
+        if(error == "") error = parse_error;
+        if(error != "") {
+            std::cout << "OVERPASS STREAM FAILED : " << error << "\n";
+            //the graph may have parsed from a response that then failed, the caller refetches
+            delete g;
+            raw.clear();
+            remark.clear();
+            return nullptr;
+        }
+        return g;
+#endif
+    }
+
     std::string make_overpass_query(ld min_lat, ld min_lon, ld max_lat, ld max_lon) {
         std::ostringstream q;
         q.imbue(std::locale::classic());         
@@ -49,23 +108,33 @@ namespace utils {
 
     Graph* create_graph(ld min_lat, ld min_lon, ld max_lat, ld max_lon) {
         try {
+            if(OSMImporter::extract_path != "") {
+                Graph* g = OSMImporter::import(OSMImporter::extract_path, min_lat, min_lon, max_lat, max_lon);
+                g->min_lat = min_lat, g->min_lon = min_lon, g->max_lat = max_lat, g->max_lon = max_lon;
+                std::cout << "GRAPH : " << g->nodes.size() << "\n";
+                return g;
+            }
+
             std::string query = make_overpass_query(min_lat, min_lon, max_lat, max_lon);
-            std::string raw = run_overpass_fetch(query);
+            std::string raw, remark;
+            Graph* g = nullptr;
+            bool cached = OverpassCache::find(query, min_lat, min_lon, max_lat, max_lon, raw);
+            if(!cached) g = run_overpass_stream(query, OverpassCache::dir != "", raw, remark);
+            if(g == nullptr) {
+                //buffered fetch with retries, used for cache hits and when streaming failed
+                if(!cached) raw = run_overpass_fetch(query);
+                OSMGraphBuilder builder;
+                parse_overpass_stream(raw, builder, &remark);
+                g = builder.build();
+            }
 
             std::cout << "QUERY : " << query << "\n";
 
-            json j = json::parse(raw);
-
-            {
-                std::set<std::string> types;
-                for(auto& [key, value] : j["elements"].items()) {
-                    if(value.is_object() && value.contains("type")) types.insert(value["type"]);
-                }
-                std::cout << "TYPES :\n";
-                for(std::string s : types) std::cout << s << "\n";
-            }
+            //overpass reports timeouts and memory limits in a remark next to partial results, don't keep those
+            if(!cached && remark == "") OverpassCache::store(query, min_lat, min_lon, max_lat, max_lon, raw);
+            if(remark != "") std::cout << "OVERPASS REMARK : " << remark << "\n";
 
-            Graph* g = Graph::parse_osm(j);
+            g->min_lat = min_lat, g->min_lon = min_lon, g->max_lat = max_lat, g->max_lon = max_lon;
             std::cout << "GRAPH : " << g->nodes.size() << "\n";
 
             return g;
@@ -77,7 +146,7 @@ namespace utils {
     }
 
     // freeform address to coordinate
-    Coordinate* geocode_freeform(const std::string& addr) {
+    Coordinate geocode_freeform(const std::string& addr) {
         std::ostringstream url;
         url << "https://nominatim.openstreetmap.org/search"
             << "?format=jsonv2&limit=1&addressdetails=1&"
@@ -95,11 +164,11 @@ namespace utils {
         ld lat = std::stold(first.at("lat").get<std::string>());
         ld lon = std::stold(first.at("lon").get<std::string>());
 
-        return new Coordinate(lat, lon);
+        return Coordinate(lat, lon);
     }
 
     // structured address to coordinate
-    Coordinate* geocode_structured(
+    Coordinate geocode_structured(
         const std::string& street,
         const std::string& city,
         const std::string& state,
@@ -127,7 +196,7 @@ namespace utils {
         ld lat = std::stold(first.at("lat").get<std::string>());
         ld lon = std::stold(first.at("lon").get<std::string>());
 
-        return new Coordinate(lat, lon);
+        return Coordinate(lat, lon);
     }
 }
 
@@ -2,23 +2,32 @@
 #include "defs.h"
 #include <string>
 #include <set>
+#include <thread>
 #include<iomanip>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include "http/http.h"
+#include "http/OverpassCache.h"
+#include "http/PipeBuf.h"
 #include "graph/Graph.h"
+#include "graph/OSMParser.h"
+#include "graph/OSMImport.h"
 
 namespace utils {
     std::string run_overpass_fetch(const std::string& query);
+
+    //fetches the query and parses the response as it downloads, without holding the whole body 
+    //unless keep_raw is set. returns nullptr if the request or the parse failed
+    Graph* run_overpass_stream(const std::string& query, bool keep_raw, std::string& raw, std::string& remark);
     std::string make_overpass_query(ld min_lat, ld min_lon, ld max_lat, ld max_lon);
     Graph* create_graph(ld min_lat, ld min_lon, ld max_lat, ld max_lon);
 
     // freeform address to coordinate
-    Coordinate* geocode_freeform(const std::string& addr);
+    Coordinate geocode_freeform(const std::string& addr);
 
     // structured address to coordinate
-    Coordinate* geocode_structured(
+    Coordinate geocode_structured(
         const std::string& street,
         const std::string& city,
         const std::string& state,
@@ -0,0 +1,130 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/defs.h"
+#include "../src/graph/Graph.h"
+
+//float against double check of the shortest path code on the fixed graph in grid.osm.json.
+//"make precision" builds this once per scalar, then the float build dumps its distances with
+//    precision dump <osm json> <out file>
+//and the double build recomputes them and checks each one with
+//    precision compare <osm json> <float file>
+//the two builds have to agree on which pairs are reachable, and reachable distances may differ by at
+//most ABS_TOL metres plus REL_TOL of the distance. a float coordinate alone is off by up to a metre
+//at this latitude, and that error adds up along a path
+const double ABS_TOL = 5, REL_TOL = 1e-3;
+
+//every SOURCE_STRIDE-th node is a source and every TARGET_STRIDE-th node a target
+const int SOURCE_STRIDE = 41, TARGET_STRIDE = 7;
+
+//within one build, get_dist, astar, bidijkstra and the table must match the sssp row up to SELF_TOL 
+//of the distance, which only allows for edge weights summed in a different order
+const double SELF_TOL = 1e-4;
+int nr_inconsistent = 0;
+
+//sssp rows, get_dist, astar, bidijkstra and distance_table of both modes, in a fixed order. unreachable is -1
+std::vector<double> run(const std::string& osm_file) {
+    std::ifstream in(osm_file);
+    if(!in) throw std::runtime_error("cannot open " + osm_file);
+    json osm = json::parse(in);
+
+    //hilbert order is computed from the coordinates, keep the parsed order so both builds number nodes alike
+    Graph::reorder_nodes_on_parse = false;
+    Graph* g = Graph::parse_osm(osm);
+    int n = g->nodes.size();
+
+    std::vector<int> sources, targets;
+    for(int u = 0; u < n; u += SOURCE_STRIDE) sources.push_back(u);
+    for(int u = 0; u < n; u += TARGET_STRIDE) targets.push_back(u);
+
+    std::vector<double> ret = {(double) n};
+    auto add = [&](ld d) { ret.push_back(d == DIST_INF ? -1 : (double) d); };
+    for(bool walkable : {true, false}) {
+        std::vector<std::vector<ld>> rows(sources.size());
+        for(int i = 0; i < sources.size(); i++) {
+            std::vector<int> prev;
+            g->sssp(sources[i], walkable, rows[i], prev);
+            for(int t : targets) add(rows[i][t]);
+        }
+        auto check = [&](int i, int t, ld d, const char* what) {
+            ld want = rows[i][t];
+            bool ok = (d == DIST_INF) == (want == DIST_INF) && (d == DIST_INF || std::abs((double) (d - want)) <= SELF_TOL * std::max(1.0, (double) want));
+            if(!ok && nr_inconsistent ++ < 10) std::cout << what << " disagrees with sssp : " << (double) d << " vs " << (double) want << "\n";
+            add(d);
+        };
+        for(int i = 0; i < sources.size(); i++) {
+            for(int t : targets) check(i, t, g->get_dist(sources[i], t, walkable), "get_dist");
+        }
+        for(int i = 0; i < sources.size(); i++) {
+            for(int t : targets) {
+                check(i, t, g->astar(sources[i], t, walkable), "astar");
+                check(i, t, g->bidijkstra(sources[i], t, walkable), "bidijkstra");
+            }
+        }
+        std::vector<ld> table = g->distance_table(sources, targets, walkable);
+        for(int i = 0; i < sources.size(); i++) {
+            for(int j = 0; j < targets.size(); j++) check(i, targets[j], table[(size_t) i * targets.size() + j], "distance_table");
+        }
+    }
+    delete g;
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    if(argc != 4 || (std::string(argv[1]) != "dump" && std::string(argv[1]) != "compare")) {
+        std::cout << "usage : precision dump|compare <osm json> <distance file>\n";
+        return 1;
+    }
+    std::string mode = argv[1];
+    std::vector<double> dist = run(argv[2]);
+    std::cout << "PRECISION : " << dist.size() - 1 << " distances with sizeof(ld) = " << sizeof(ld) << "\n";
+    if(nr_inconsistent != 0) {
+        std::cout << "PRECISION : FAILED, " << nr_inconsistent << " point to point or table distances disagree with sssp\n";
+        return 1;
+    }
+
+    if(mode == "dump") {
+        FILE* out = fopen(argv[3], "w");
+        if(out == nullptr) {
+            std::cout << "cannot write " << argv[3] << "\n";
+            return 1;
+        }
+        for(double d : dist) fprintf(out, "%.17g\n", d);
+        fclose(out);
+        return 0;
+    }
+
+    std::ifstream in(argv[3]);
+    std::vector<double> other;
+    double x;
+    while(in >> x) other.push_back(x);
+    if(other.size() != dist.size() || other[0] != dist[0]) {
+        std::cout << "PRECISION : FAILED, " << argv[3] << " holds a different graph or query set\n";
+        return 1;
+    }
+
+    int nr_bad = 0;
+    double max_abs = 0, max_rel = 0;
+    for(size_t i = 1; i < dist.size(); i++) {
+        double a = dist[i], b = other[i];
+        if((a < 0) != (b < 0)) {
+            if(nr_bad ++ < 10) std::cout << "reachability differs at " << i << " : " << a << " vs " << b << "\n";
+            continue;
+        }
+        if(a < 0) continue;
+        double err = std::abs(a - b);
+        max_abs = std::max(max_abs, err);
+        if(a > 0) max_rel = std::max(max_rel, err / a);
+        if(err > ABS_TOL + REL_TOL * a) {
+            if(nr_bad ++ < 10) std::cout << "distance differs at " << i << " : " << a << " vs " << b << "\n";
+        }
+    }
+    std::cout << "PRECISION : max error " << max_abs << " m, " << max_rel * 100 << "% relative, "
+              << nr_bad << " outside " << ABS_TOL << " m + " << REL_TOL * 100 << "%\n";
+    std::cout << "PRECISION : " << (nr_bad == 0 ? "OK" : "FAILED") << "\n";
+    return nr_bad != 0;
+}